@@ -26,6 +26,7 @@ Graphics3::VertexBuffer::VertexBuffer(int vertexCount, const Graphics4::VertexSt
 		Graphics4::VertexElement element = structure.elements[i];
 		switch (element.data) {
 		case Graphics4::ColorVertexData:
+		case Graphics4::Byte4NormVertexData:
 			myStride += 1 * 4;
 			break;
 		case Graphics4::Float1VertexData:
@@ -114,6 +115,7 @@ int VertexBufferImpl::setVertexAttributes(int offset) {
 
 		switch (element.data) {
 		case Graphics4::ColorVertexData:
+		case Graphics4::Byte4NormVertexData:
 			size = 4;
 			type = GL_UNSIGNED_BYTE;
 			break;
@@ -182,6 +184,7 @@ int VertexBufferImpl::setVertexAttributes(int offset) {
 
 		switch (element.data) {
 		case Graphics4::ColorVertexData:
+		case Graphics4::Byte4NormVertexData:
 			internaloffset += 4 * 1;
 			break;
 		case Graphics4::Float1VertexData:
@@ -420,6 +420,12 @@ void Graphics4::PipelineState::compile() {
 				vertexDesc[i].Format = DXGI_FORMAT_R8G8B8A8_UINT;
 				++i;
 				break;
+			case Byte4NormVertexData:
+				setVertexDesc(vertexDesc[i], getAttributeLocation(vertexShader->attributes, inputLayout[stream]->elements[index].name, used), index, stream,
+				              inputLayout[stream]->instanced);
+				vertexDesc[i].Format = DXGI_FORMAT_R8G8B8A8_UNORM;
+				++i;
+				break;
 			case Float4x4VertexData:
 				char name[101];
 				strcpy(name, inputLayout[stream]->elements[index].name);
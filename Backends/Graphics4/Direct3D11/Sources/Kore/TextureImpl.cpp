@@ -267,6 +267,11 @@ void Graphics4::Texture::unlock() {
 	context->Unmap(texture, 0);
 }
 
+// the whole texture is mapped for writing
+void Graphics4::Texture::unlock(int x, int y, int width, int height) {
+	unlock();
+}
+
 void Graphics4::Texture::clear(int x, int y, int z, int width, int height, int depth, uint color) {
 	if (renderView == nullptr) {
 		texDepth > 1 ? 
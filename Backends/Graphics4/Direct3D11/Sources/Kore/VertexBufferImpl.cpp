@@ -26,6 +26,7 @@ Graphics4::VertexBuffer::VertexBuffer(int count, const VertexStructure& structur
 			myStride += 4 * 4;
 			break;
 		case ColorVertexData:
+		case Byte4NormVertexData:
 			myStride += 1 * 4;
 			break;
 		case Float4x4VertexData:
@@ -82,15 +83,27 @@ float* Graphics4::VertexBuffer::lock(int start, int count) {
 }
 
 void Graphics4::VertexBuffer::unlock() {
+	unlock(lockCount);
+}
+
+void Graphics4::VertexBuffer::unlock(int count) {
 	if (usage == DynamicUsage) {
 		D3D11_MAPPED_SUBRESOURCE mappedResource;
 		ZeroMemory(&mappedResource, sizeof(D3D11_MAPPED_SUBRESOURCE));
-		context->Map(_vb, 0, D3D11_MAP_WRITE_DISCARD, 0, &mappedResource);
-		memcpy(mappedResource.pData, &vertices[lockStart * myStride / 4], (lockCount * myStride / 4) * sizeof(float));
+		// appending behind the last locked range must not discard what earlier draws still read
+		context->Map(_vb, 0, lockStart == 0 ? D3D11_MAP_WRITE_DISCARD : D3D11_MAP_WRITE_NO_OVERWRITE, 0, &mappedResource);
+		memcpy(&((u8*)mappedResource.pData)[lockStart * myStride], &vertices[lockStart * myStride / 4], count * myStride);
 		context->Unmap(_vb, 0);
 	}
 	else {
-		context->UpdateSubresource(_vb, 0, nullptr, vertices, 0, 0);
+		D3D11_BOX box;
+		box.left = lockStart * myStride;
+		box.right = (lockStart + count) * myStride;
+		box.top = 0;
+		box.bottom = 1;
+		box.front = 0;
+		box.back = 1;
+		context->UpdateSubresource(_vb, 0, &box, &vertices[lockStart * myStride / 4], 0, 0);
 	}
 }
 
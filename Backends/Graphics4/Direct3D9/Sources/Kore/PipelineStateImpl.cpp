@@ -104,6 +104,18 @@ void Graphics4::PipelineState::compile() {
 				elements[i].Type = D3DDECLTYPE_D3DCOLOR;
 				stride += 4;
 				break;
+			case Byte4NormVertexData:
+				elements[i].Type = D3DDECLTYPE_UBYTE4N;
+				stride += 4;
+				break;
+			case Short2NormVertexData:
+				elements[i].Type = D3DDECLTYPE_SHORT2N;
+				stride += 2 * 2;
+				break;
+			case Short4NormVertexData:
+				elements[i].Type = D3DDECLTYPE_SHORT4N;
+				stride += 2 * 4;
+				break;
 			case Float4x4VertexData:
 				for (int i2 = 0; i2 < 4; ++i2) {
 					elements[i].Stream = stream;
@@ -102,6 +102,10 @@ void Graphics4::Texture::unlock() {
 	Microsoft::affirm(texture->UnlockRect(0));
 }
 
+void Graphics4::Texture::unlock(int x, int y, int width, int height) {
+	unlock();
+}
+
 void Graphics4::Texture::clear(int x, int y, int z, int width, int height, int depth, uint color) {}
 
 int Graphics4::Texture::stride() {
@@ -34,8 +34,15 @@ Graphics4::VertexBuffer::VertexBuffer(int count, const VertexStructure& structur
 			myStride += 4 * 4;
 			break;
 		case ColorVertexData:
+		case Byte4NormVertexData:
 			myStride += 4;
 			break;
+		case Short2NormVertexData:
+			myStride += 2 * 2;
+			break;
+		case Short4NormVertexData:
+			myStride += 2 * 4;
+			break;
 		case Float4x4VertexData:
 			myStride += 4 * 4 * 4;
 			break;
@@ -56,7 +63,7 @@ float* Graphics4::VertexBuffer::lock() {
 float* Graphics4::VertexBuffer::lock(int start, int count) {
 	float* vertices;
 	unset();
-	Microsoft::affirm(vb->Lock(start, count * stride(), (void**)&vertices, D3DLOCK_DISCARD));
+	Microsoft::affirm(vb->Lock(start * stride(), count * stride(), (void**)&vertices, start == 0 ? D3DLOCK_DISCARD : D3DLOCK_NOOVERWRITE));
 	return vertices;
 }
 
@@ -64,6 +71,10 @@ void Graphics4::VertexBuffer::unlock() {
 	Microsoft::affirm(vb->Unlock());
 }
 
+void Graphics4::VertexBuffer::unlock(int count) {
+	unlock();
+}
+
 int Graphics4::VertexBuffer::_set(int offset) {
 	_offset = offset;
 	if (instanceDataStepRate == 0) {
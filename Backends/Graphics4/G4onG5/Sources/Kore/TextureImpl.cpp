@@ -120,6 +120,10 @@ void Graphics4::Texture::unlock() {
 	_texture->unlock();
 }
 
+void Graphics4::Texture::unlock(int x, int y, int width, int height) {
+	_texture->unlock();
+}
+
 void Graphics4::Texture::clear(int x, int y, int z, int width, int height, int depth, uint color) {
 	_texture->clear(x, y, z, width, height, depth, color);
 }
@@ -16,6 +16,7 @@ ShaderStorageBuffer::ShaderStorageBuffer(int indexCount, Graphics4::VertexData t
 	myStride = 0;
 	switch (type) {
 	case Graphics4::ColorVertexData:
+	case Graphics4::Byte4NormVertexData:
 		myStride += 1 * 4;
 		break;
 	case Graphics4::Float1VertexData:
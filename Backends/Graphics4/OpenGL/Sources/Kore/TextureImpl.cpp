@@ -557,6 +557,25 @@ void Graphics4::Texture::unlock() {
 	glCheckErrors();
 }
 
+void Graphics4::Texture::unlock(int x, int y, int width, int height) {
+	if (depth > 1 || convertType(format) == GL_FLOAT) {
+		unlock();
+		return;
+	}
+	if (width <= 0 || height <= 0) return;
+	glBindTexture(GL_TEXTURE_2D, texture);
+	glCheckErrors();
+#ifdef KORE_OPENGL_ES
+	// no GL_UNPACK_ROW_LENGTH everywhere, whole rows are contiguous though
+	glTexSubImage2D(GL_TEXTURE_2D, 0, 0, y, texWidth, height, convertFormat(format), convertType(format), &data[y * stride()]);
+#else
+	glPixelStorei(GL_UNPACK_ROW_LENGTH, texWidth);
+	glTexSubImage2D(GL_TEXTURE_2D, 0, x, y, width, height, convertFormat(format), convertType(format), &data[y * stride() + x * sizeOf(format)]);
+	glPixelStorei(GL_UNPACK_ROW_LENGTH, 0);
+#endif
+	glCheckErrors();
+}
+
 void Graphics4::Texture::clear(int x, int y, int z, int width, int height, int depth, uint color) {
 #ifdef GL_VERSION_4_4
 	static float clearColor[4];
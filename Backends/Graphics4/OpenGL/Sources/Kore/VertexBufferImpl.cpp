@@ -24,6 +24,7 @@ Graphics4::VertexBuffer::VertexBuffer(int vertexCount, const VertexStructure& st
 		VertexElement element = structure.elements[i];
 		switch (element.data) {
 		case ColorVertexData:
+		case Byte4NormVertexData:
 			myStride += 1 * 4;
 			break;
 		case Float1VertexData:
@@ -92,10 +93,20 @@ float* Graphics4::VertexBuffer::lock(int start, int count) {
 }
 
 void Graphics4::VertexBuffer::unlock() {
+	unlock(sectionSize / myStride);
+}
+
+void Graphics4::VertexBuffer::unlock(int count) {
 	glBindBuffer(GL_ARRAY_BUFFER, bufferId);
 	glCheckErrors();
+	if (usage == GL_DYNAMIC_DRAW && sectionStart == 0 && sectionSize == myCount * myStride) {
+		// a lock of the whole buffer replaces all of it, so the old storage is orphaned
+		// instead of waiting for draws which still read from it
+		glBufferData(GL_ARRAY_BUFFER, myStride * myCount, nullptr, usage);
+		glCheckErrors();
+	}
 	u8* u8data = (u8*)data;
-	glBufferSubData(GL_ARRAY_BUFFER, sectionStart, sectionSize, u8data + sectionStart);
+	glBufferSubData(GL_ARRAY_BUFFER, sectionStart, count * myStride, u8data + sectionStart);
 	glCheckErrors();
 #ifndef NDEBUG
 	initialized = true;
@@ -139,6 +150,7 @@ int VertexBufferImpl::setVertexAttributes(int offset) {
 		GLenum type = GL_FLOAT;
 		switch (element.data) {
 		case Graphics4::ColorVertexData:
+		case Graphics4::Byte4NormVertexData:
 			size = 4;
 			type = GL_UNSIGNED_BYTE;
 			break;
@@ -204,6 +216,7 @@ int VertexBufferImpl::setVertexAttributes(int offset) {
 		}
 		switch (element.data) {
 		case Graphics4::ColorVertexData:
+		case Graphics4::Byte4NormVertexData:
 			internaloffset += 4 * 1;
 			break;
 		case Graphics4::Float1VertexData:
@@ -186,6 +186,9 @@ void Graphics5::PipelineState::compile() {
 		case Graphics4::ColorVertexData:
 			vertexDesc[i].Format = DXGI_FORMAT_R8G8B8A8_UINT;
 			break;
+		case Graphics4::Byte4NormVertexData:
+			vertexDesc[i].Format = DXGI_FORMAT_R8G8B8A8_UNORM;
+			break;
 		case Graphics4::Short2NormVertexData:
 			vertexDesc[i].Format = DXGI_FORMAT_R16G16_SNORM;
 			break;
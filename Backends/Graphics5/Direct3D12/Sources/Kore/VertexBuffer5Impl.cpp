@@ -31,6 +31,7 @@ Graphics5::VertexBuffer::VertexBuffer(int count, const VertexStructure& structur
 			myStride += 4 * 4;
 			break;
 		case Graphics4::ColorVertexData:
+		case Graphics4::Byte4NormVertexData:
 			myStride += 1 * 4;
 			break;
 		case Graphics4::Short2NormVertexData:
@@ -124,6 +124,18 @@ void Graphics5::PipelineState::compile() {
 			vertexDescriptor.attributes[index].format = MTLVertexFormatFloat4;
 			offset += 4 * sizeof(float);
 			break;
+		case Graphics4::Byte4NormVertexData:
+			vertexDescriptor.attributes[index].format = MTLVertexFormatUChar4Normalized;
+			offset += 4;
+			break;
+		case Graphics4::Short2NormVertexData:
+			vertexDescriptor.attributes[index].format = MTLVertexFormatShort2Normalized;
+			offset += 2 * sizeof(short);
+			break;
+		case Graphics4::Short4NormVertexData:
+			vertexDescriptor.attributes[index].format = MTLVertexFormatShort4Normalized;
+			offset += 4 * sizeof(short);
+			break;
 		default:
 			break;
 		}
@@ -199,6 +199,7 @@ void Graphics5::PipelineState::compile() {
 		VertexElement element = inputLayout[0]->elements[i];
 		switch (element.data) {
 		case Graphics4::ColorVertexData:
+		case Graphics4::Byte4NormVertexData:
 			stride += 1 * 4;
 			break;
 		case Graphics4::Float1VertexData:
@@ -216,6 +217,12 @@ void Graphics5::PipelineState::compile() {
 		case Graphics4::Float4x4VertexData:
 			stride += 4 * 4 * 4;
 			break;
+		case Graphics4::Short2NormVertexData:
+			stride += 2 * 2;
+			break;
+		case Graphics4::Short4NormVertexData:
+			stride += 4 * 2;
+			break;
 		}
 	}
 
@@ -249,6 +256,13 @@ void Graphics5::PipelineState::compile() {
 			vi_attrs[i].offset = offset;
 			offset += 1 * 4;
 			break;
+		case Graphics4::Byte4NormVertexData:
+			vi_attrs[i].binding = 0;
+			vi_attrs[i].location = vertexLocations[element.name];
+			vi_attrs[i].format = VK_FORMAT_R8G8B8A8_UNORM;
+			vi_attrs[i].offset = offset;
+			offset += 1 * 4;
+			break;
 		case Graphics4::Float1VertexData:
 			vi_attrs[i].binding = 0;
 			vi_attrs[i].location = vertexLocations[element.name];
@@ -284,6 +298,20 @@ void Graphics5::PipelineState::compile() {
 			vi_attrs[i].offset = offset;
 			offset += 4 * 4 * 4;
 			break;
+		case Graphics4::Short2NormVertexData:
+			vi_attrs[i].binding = 0;
+			vi_attrs[i].location = vertexLocations[element.name];
+			vi_attrs[i].format = VK_FORMAT_R16G16_SNORM;
+			vi_attrs[i].offset = offset;
+			offset += 2 * 2;
+			break;
+		case Graphics4::Short4NormVertexData:
+			vi_attrs[i].binding = 0;
+			vi_attrs[i].location = vertexLocations[element.name];
+			vi_attrs[i].format = VK_FORMAT_R16G16B16A16_SNORM;
+			vi_attrs[i].offset = offset;
+			offset += 4 * 2;
+			break;
 		}
 	}
 
@@ -28,6 +28,7 @@ Graphics5::VertexBuffer::VertexBuffer(int vertexCount, const VertexStructure& st
 		VertexElement element = structure.elements[i];
 		switch (element.data) {
 		case Graphics4::ColorVertexData:
+		case Graphics4::Byte4NormVertexData:
 			myStride += 1 * 4;
 			break;
 		case Graphics4::Float1VertexData:
@@ -45,6 +46,12 @@ Graphics5::VertexBuffer::VertexBuffer(int vertexCount, const VertexStructure& st
 		case Graphics4::Float4x4VertexData:
 			myStride += 4 * 4 * 4;
 			break;
+		case Graphics4::Short2NormVertexData:
+			myStride += 2 * 2;
+			break;
+		case Graphics4::Short4NormVertexData:
+			myStride += 4 * 2;
+			break;
 		}
 	}
 	this->structure = structure;
@@ -33,6 +33,12 @@ static void* ThreadProc(void* arg) {
 Thread* Kore::createAndRunThread(void (*thread)(void* param), void* param) {
 	mutex.lock();
 
+	// slots are never given back
+	if (threadindex >= MAX_THREADS) {
+		mutex.unlock();
+		return nullptr;
+	}
+
 	uint i = threadindex++; // ia.AllocateIndex();
 	// ktassert_d(i != 0xFFFFFFFF);
 
@@ -2,16 +2,53 @@
 
 #include <Kore/Threads/Semaphore.h>
 
+#include <errno.h>
+#include <sys/time.h>
+
 using namespace Kore;
 
-void Semaphore::create(int current, int max) {}
+// pthread mutex and condition because unnamed POSIX semaphores are not available on macOS
+void Semaphore::create(int current, int max) {
+	pthread_mutex_init(&mutex, nullptr);
+	pthread_cond_init(&condition, nullptr);
+	count = current;
+	this->max = max;
+}
 
-void Semaphore::destroy() {}
+void Semaphore::destroy() {
+	pthread_cond_destroy(&condition);
+	pthread_mutex_destroy(&mutex);
+}
 
-void Semaphore::release(int count) {}
+void Semaphore::release(int count) {
+	if (count <= 0) return;
+	pthread_mutex_lock(&mutex);
+	this->count += count;
+	if (this->count > max) this->count = max;
+	pthread_cond_broadcast(&condition);
+	pthread_mutex_unlock(&mutex);
+}
 
-void Semaphore::acquire() {}
+void Semaphore::acquire() {
+	pthread_mutex_lock(&mutex);
+	while (count <= 0) pthread_cond_wait(&condition, &mutex);
+	--count;
+	pthread_mutex_unlock(&mutex);
+}
 
 bool Semaphore::tryToAcquire(double seconds) {
-	return true;
+	timeval now;
+	gettimeofday(&now, nullptr);
+	long long nanoseconds = (long long)now.tv_usec * 1000 + (long long)(seconds * 1000000000.0);
+	timespec timeout;
+	timeout.tv_sec = now.tv_sec + (time_t)(nanoseconds / 1000000000);
+	timeout.tv_nsec = (long)(nanoseconds % 1000000000);
+
+	pthread_mutex_lock(&mutex);
+	int result = 0;
+	while (count <= 0 && result != ETIMEDOUT) result = pthread_cond_timedwait(&condition, &mutex, &timeout);
+	bool acquired = count > 0;
+	if (acquired) --count;
+	pthread_mutex_unlock(&mutex);
+	return acquired;
 }
@@ -1,7 +1,13 @@
 #pragma once
 
+#include <pthread.h>
+
 namespace Kore {
 	class SemaphoreImpl {
 	protected:
+		pthread_mutex_t mutex;
+		pthread_cond_t condition;
+		int count;
+		int max;
 	};
 }
@@ -19,6 +19,7 @@ VertexBuffer::VertexBuffer(int count, const VertexStructure& structure, int inst
 		VertexElement element = structure.elements[i];
 		switch (element.data) {
 		case ColorVertexData:
+		case Byte4NormVertexData:
 			myStride += 1 * 4;
 			break;
 		case Float1VertexData:
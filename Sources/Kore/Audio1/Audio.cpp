@@ -3,22 +3,193 @@
 #include "Audio.h"
 
 #include <Kore/Audio2/Audio.h>
+#include <Kore/Log.h>
 #include <Kore/Math/Core.h>
-#include <Kore/Threads/Mutex.h>
-#if 0
-#include <xmmintrin.h>
-#endif
+#include <Kore/Simd/float32x4.h>
 #include <Kore/VideoSoundStream.h>
 
+#include <atomic>
+#include <unordered_map>
+#include <vector>
+
 using namespace Kore;
 
 namespace {
-	Mutex mutex;
+	const int streamCount = 16;
+	// Voices quieter than this are advanced without being rendered
+	const float inaudible = 1.0f / 65536.0f;
+
+	int voiceCount = 0;
+
+	// Frames mixed per pass, a multiple of four
+	const int blockSize = 256;
+	float mixLeft[blockSize];
+	float mixRight[blockSize];
+	float voiceLeft[blockSize];
+	float voiceRight[blockSize];
+
+	// Game thread side, the mixer reports finished voices through endedGenerations
+	struct Channel {
+		Sound* sound;
+		bool loop;
+		float volume;
+		float pitch;
+		int priority;
+		u32 generation;
+		int previous, next; // voices playing the same sound
+	};
+	Channel* channels = nullptr;
+	std::vector<int> freeChannels;
+	std::unordered_map<Sound*, int> soundChannels;
+
+	// Mixer side, only touched by the audio thread
+	struct MixerVoice {
+		Sound* sound;
+		float position;
+		bool loop;
+		float volume;
+		float pitch;
+		u32 generation;
+		int activeIndex;
+		SoundDecoder* decoder;
+	};
+	MixerVoice* voices = nullptr;
+	std::vector<int> activeVoices;
+	Audio1::StreamChannel streams[streamCount];
+	Audio1::VideoChannel videos[streamCount];
+	std::atomic<u32>* endedGenerations = nullptr;
+
+	struct Command {
+		enum Type { PlaySound, StopSound, SetVolume, SetPitch, PlayStream, StopStream, PlayVideo, StopVideo };
+
+		Type type;
+		int channel;
+		u32 generation;
+		Sound* sound;
+		SoundDecoder* decoder;
+		SoundStream* stream;
+		VideoSoundStream* video;
+		bool loop;
+		float value;
+	};
+
+	// Single producer single consumer ring from the game thread to the mixer
+	int commandCount = 0;
+	Command* commands = nullptr;
+	std::atomic<int> commandRead;
+	std::atomic<int> commandWrite;
+
+	bool full() {
+		return (commandWrite.load(std::memory_order_relaxed) + 1) % commandCount == commandRead.load(std::memory_order_acquire);
+	}
+
+	bool push(const Command& command) {
+		if (full()) {
+			log(Warning, "Audio1 command queue is full.");
+			return false;
+		}
+		int write = commandWrite.load(std::memory_order_relaxed);
+		commands[write] = command;
+		commandWrite.store((write + 1) % commandCount, std::memory_order_release);
+		return true;
+	}
+
+	// Single producer single consumer ring from the mixer back to the game thread, finished decoders are freed there.
+	// Every decoder sits in a command, a voice or this ring and play drains it before creating one, so it never fills up.
+	int retiredCount = 0;
+	SoundDecoder** retired = nullptr;
+	std::atomic<int> retiredRead;
+	std::atomic<int> retiredWrite;
+
+	void retire(SoundDecoder* decoder) {
+		int write = retiredWrite.load(std::memory_order_relaxed);
+		retired[write] = decoder;
+		retiredWrite.store((write + 1) % retiredCount, std::memory_order_release);
+	}
+
+	void collect() {
+		int read = retiredRead.load(std::memory_order_relaxed);
+		int write = retiredWrite.load(std::memory_order_acquire);
+		while (read != write) {
+			delete retired[read];
+			read = (read + 1) % retiredCount;
+		}
+		retiredRead.store(read, std::memory_order_release);
+	}
+
+	Command command(Command::Type type) {
+		Command command;
+		command.type = type;
+		command.channel = -1;
+		command.generation = 0;
+		command.sound = nullptr;
+		command.decoder = nullptr;
+		command.stream = nullptr;
+		command.video = nullptr;
+		command.loop = false;
+		command.value = 0;
+		return command;
+	}
+
+	bool active(int channel) {
+		return channels[channel].sound != nullptr && endedGenerations[channel].load(std::memory_order_acquire) != channels[channel].generation;
+	}
+
+	bool current(Audio1::Voice voice) {
+		return voice.index >= 0 && voice.index < voiceCount && channels[voice.index].generation == voice.generation && active(voice.index);
+	}
+
+	void link(int channel) {
+		Channel& c = channels[channel];
+		std::unordered_map<Sound*, int>::iterator first = soundChannels.find(c.sound);
+		c.previous = -1;
+		c.next = first == soundChannels.end() ? -1 : first->second;
+		if (c.next >= 0) channels[c.next].previous = channel;
+		soundChannels[c.sound] = channel;
+	}
+
+	void unlink(int channel) {
+		Channel& c = channels[channel];
+		if (c.next >= 0) channels[c.next].previous = c.previous;
+		if (c.previous >= 0) channels[c.previous].next = c.next;
+		else if (c.next >= 0) soundChannels[c.sound] = c.next;
+		else soundChannels.erase(c.sound);
+	}
+
+	// The voice has ended or was stopped, its slot can be played again
+	void release(int channel) {
+		unlink(channel);
+		channels[channel].sound = nullptr;
+		freeChannels.push_back(channel);
+	}
+
+	float audibility(int channel) {
+		return channels[channel].volume * channels[channel].sound->volume();
+	}
+
+	int allocate(int priority) {
+		if (freeChannels.empty()) {
+			for (int i = 0; i < voiceCount; ++i) {
+				if (channels[i].sound != nullptr && !active(i)) release(i);
+			}
+		}
+		if (!freeChannels.empty()) {
+			int channel = freeChannels.back();
+			freeChannels.pop_back();
+			return channel;
+		}
 
-	const int channelCount = 16;
-	Audio1::Channel channels[channelCount];
-	Audio1::StreamChannel streams[channelCount];
-	Audio1::VideoChannel videos[channelCount];
+		int victim = -1;
+		for (int i = 0; i < voiceCount; ++i) {
+			if (channels[i].priority > priority) continue;
+			if (victim < 0 || channels[i].priority < channels[victim].priority ||
+			    (channels[i].priority == channels[victim].priority && audibility(i) < audibility(victim))) {
+				victim = i;
+			}
+		}
+		if (victim >= 0) unlink(victim);
+		return victim;
+	}
 
 	float sampleLinear(s16* data, float position) {
 		int pos1 = (int)position;
@@ -44,183 +215,402 @@ namespace {
 	    float c3 = 0.5f * (s3 - s0) + 1.5f * (s1 - s2);
 	    return ((c3 * x + c2) * x + c1) * x + c0;
 	}*/
-}
 
-void Audio1::mix(int samples) {
-	for (int i = 0; i < samples; ++i) {
-		bool left = (i % 2) == 0;
-		float value = 0;
-#if 0
-		__m128 sseSamples[4];
-		for (int i = 0; i < channelCount; i += 4) {
-			s16 data[4];
-			for (int i2 = 0; i2 < 4; ++i2) {
-				if (channels[i + i2].sound != nullptr) {
-					data[i2] = *(s16*)&channels[i + i2].sound->data[channels[i + i2].position];
-					channels[i + i2].position += 2;
-					if (channels[i + i2].position >= channels[i + i2].sound->size) channels[i + i2].sound = nullptr;
+	void silence(float* left, float* right, int start, int frames) {
+		for (int i = start; i < frames; ++i) {
+			left[i] = 0;
+			right[i] = 0;
+		}
+	}
+
+	void activate(int channel) {
+		if (voices[channel].activeIndex >= 0) return;
+		voices[channel].activeIndex = static_cast<int>(activeVoices.size());
+		activeVoices.push_back(channel);
+	}
+
+	void deactivate(int channel) {
+		int index = voices[channel].activeIndex;
+		if (index < 0) return;
+		int last = activeVoices.back();
+		activeVoices[index] = last;
+		voices[last].activeIndex = index;
+		activeVoices.pop_back();
+		voices[channel].activeIndex = -1;
+	}
+
+	// Decoders are created on the game thread and handed back to it once their voice is done
+	void stopVoice(MixerVoice& voice) {
+		voice.sound = nullptr;
+		if (voice.decoder != nullptr) retire(voice.decoder);
+		voice.decoder = nullptr;
+	}
+
+	void end(int channel) {
+		MixerVoice& voice = voices[channel];
+		stopVoice(voice);
+		endedGenerations[channel].store(voice.generation, std::memory_order_release);
+	}
+
+	void renderSound(int channel, int frames) {
+		MixerVoice& voice = voices[channel];
+		Sound* sound = voice.sound;
+		float step = voice.pitch / sound->sampleRatePos;
+		for (int i = 0; i < frames; ++i) {
+			if (voice.decoder != nullptr) {
+				voice.decoder->sample(voice.position, voiceLeft[i], voiceRight[i]);
+			}
+			else {
+				voiceLeft[i] = sampleLinear(sound->left, voice.position);
+				voiceRight[i] = sound->right == sound->left ? voiceLeft[i] : sampleLinear(sound->right, voice.position);
+			}
+			voice.position += step;
+			if (voice.position + 1 >= sound->size) {
+				if (voice.loop) {
+					voice.position = 0;
 				}
 				else {
-					data[i2] = 0;
+					end(channel);
+					silence(voiceLeft, voiceRight, i + 1, frames);
+					return;
 				}
 			}
-			sseSamples[i / 4] = _mm_set_ps(data[3] / 32767.0f, data[2] / 32767.0f, data[1] / 32767.0f, data[0] / 32767.0f);
-		}
-		__m128 a = _mm_add_ps(sseSamples[0], sseSamples[1]);
-		__m128 b = _mm_add_ps(sseSamples[2], sseSamples[3]);
-		__m128 c = _mm_add_ps(a, b);
-		value = c.m128_f32[0] + c.m128_f32[1] + c.m128_f32[2] + c.m128_f32[3];
-		value = max(min(value, 1.0f), -1.0f);
-#else
-		mutex.lock();
-		for (int i = 0; i < channelCount; ++i) {
-			if (channels[i].sound != nullptr) {
-				// value += *(s16*)&channels[i].sound->data[(int)channels[i].position] / 32767.0f * channels[i].sound->volume();
-				if (left)
-					value += sampleLinear(channels[i].sound->left, channels[i].position) * channels[i].volume * channels[i].sound->volume();
-				else
-					value += sampleLinear(channels[i].sound->right, channels[i].position) * channels[i].volume * channels[i].sound->volume();
-				value = max(min(value, 1.0f), -1.0f);
-				if (!left) channels[i].position += channels[i].pitch / channels[i].sound->sampleRatePos;
-				// channels[i].position += 2;
-				if (channels[i].position + 1 >= channels[i].sound->size) {
-					if (channels[i].loop) {
-						channels[i].position = 0;
-					}
-					else {
-						channels[i].sound = nullptr;
-					}
-				}
+		}
+	}
+
+	// Keeps culled voices in time so they resume at the right spot
+	void skipSound(int channel, int frames) {
+		MixerVoice& voice = voices[channel];
+		Sound* sound = voice.sound;
+		voice.position += voice.pitch / sound->sampleRatePos * frames;
+		if (voice.position + 1 >= sound->size) {
+			if (voice.loop && sound->size > 1) {
+				while (voice.position + 1 >= sound->size) voice.position -= sound->size - 1;
+			}
+			else {
+				end(channel);
 			}
 		}
-		for (int i = 0; i < channelCount; ++i) {
-			if (streams[i].stream != nullptr) {
-				value += streams[i].stream->nextSample() * streams[i].stream->volume();
-				value = max(min(value, 1.0f), -1.0f);
-				if (streams[i].stream->ended()) streams[i].stream = nullptr;
+	}
+
+	// Sound streams are decoded on their own thread and hand over whole blocks
+	void renderStream(SoundStream*& stream, int frames) {
+		stream->read(voiceLeft, voiceRight, frames);
+		if (stream->ended()) stream = nullptr;
+	}
+
+	template <class Stream> void renderStream(Stream*& stream, int frames) {
+		for (int i = 0; i < frames; ++i) {
+			voiceLeft[i] = stream->nextSample();
+			voiceRight[i] = stream->nextSample();
+			if (stream->ended()) {
+				stream = nullptr;
+				silence(voiceLeft, voiceRight, i + 1, frames);
+				return;
 			}
 		}
-		for (int i = 0; i < channelCount; ++i) {
-			if (videos[i].stream != nullptr) {
-				value += videos[i].stream->nextSample();
-				value = max(min(value, 1.0f), -1.0f);
-				if (videos[i].stream->ended()) videos[i].stream = nullptr;
+	}
+
+	// mix += voice * gain, frames is rounded up to whole vectors
+	void accumulate(float* mix, const float* voice, float gain, int frames) {
+		float32x4 gains = loadAll(gain);
+		for (int i = 0; i < frames; i += 4) {
+			store(&mix[i], add(Kore::load(&mix[i]), mul(Kore::load(&voice[i]), gains)));
+		}
+	}
+
+	void accumulateVoice(float gain, int frames) {
+		accumulate(mixLeft, voiceLeft, gain, frames);
+		accumulate(mixRight, voiceRight, gain, frames);
+	}
+
+	template <class Slot, class Stream> void remove(Slot* slots, Stream* stream) {
+		for (int i = 0; i < streamCount; ++i) {
+			if (slots[i].stream == stream) {
+				slots[i].stream = nullptr;
+				slots[i].position = 0;
+				break;
 			}
 		}
-		mutex.unlock();
-#endif
+	}
+
+	template <class Slot, class Stream> void add(Slot* slots, Stream* stream) {
+		for (int i = 0; i < streamCount; ++i) {
+			if (slots[i].stream == nullptr) {
+				slots[i].stream = stream;
+				slots[i].position = 0;
+				break;
+			}
+		}
+	}
+
+	void execute(const Command& command) {
+		MixerVoice* voice = command.channel >= 0 ? &voices[command.channel] : nullptr;
+		switch (command.type) {
+		case Command::PlaySound:
+			stopVoice(*voice);
+			voice->sound = command.sound;
+			voice->decoder = command.decoder;
+			voice->position = 0;
+			voice->loop = command.loop;
+			voice->pitch = command.value;
+			voice->volume = 1.0f;
+			voice->generation = command.generation;
+			activate(command.channel);
+			break;
+		case Command::StopSound:
+			if (voice->generation == command.generation) {
+				stopVoice(*voice);
+				deactivate(command.channel);
+			}
+			break;
+		case Command::SetVolume:
+			if (voice->generation == command.generation) voice->volume = command.value;
+			break;
+		case Command::SetPitch:
+			if (voice->generation == command.generation) voice->pitch = command.value;
+			break;
+		case Command::PlayStream:
+			remove(streams, command.stream);
+			add(streams, command.stream);
+			break;
+		case Command::StopStream:
+			remove(streams, command.stream);
+			break;
+		case Command::PlayVideo:
+			add(videos, command.video);
+			break;
+		case Command::StopVideo:
+			remove(videos, command.video);
+			break;
+		}
+	}
+
+	// Runs on the audio thread and never waits for the game thread
+	void executeCommands() {
+		int read = commandRead.load(std::memory_order_relaxed);
+		int write = commandWrite.load(std::memory_order_acquire);
+		while (read != write) {
+			execute(commands[read]);
+			read = (read + 1) % commandCount;
+		}
+		commandRead.store(read, std::memory_order_release);
+	}
+
+	void mixBlock(int frames) {
+		int vectorFrames = (frames + 3) & ~3;
+		float32x4 zero = loadAll(0);
+		for (int i = 0; i < vectorFrames; i += 4) {
+			store(&mixLeft[i], zero);
+			store(&mixRight[i], zero);
+		}
+
+		executeCommands();
+		for (unsigned n = 0; n < activeVoices.size();) {
+			int i = activeVoices[n];
+			float gain = voices[i].volume * voices[i].sound->volume();
+			if (gain < inaudible) {
+				skipSound(i, frames);
+			}
+			else {
+				renderSound(i, frames);
+				accumulateVoice(gain, vectorFrames);
+			}
+			if (voices[i].sound == nullptr) deactivate(i);
+			else ++n;
+		}
+		for (int i = 0; i < streamCount; ++i) {
+			if (streams[i].stream == nullptr) continue;
+			float gain = streams[i].stream->volume();
+			renderStream(streams[i].stream, frames);
+			accumulateVoice(gain, vectorFrames);
+		}
+		for (int i = 0; i < streamCount; ++i) {
+			if (videos[i].stream == nullptr) continue;
+			renderStream(videos[i].stream, frames);
+			accumulateVoice(1.0f, vectorFrames);
+		}
+
+		float32x4 minimum = loadAll(-1.0f);
+		float32x4 maximum = loadAll(1.0f);
+		for (int i = 0; i < vectorFrames; i += 4) {
+			store(&mixLeft[i], Kore::max(Kore::min(Kore::load(&mixLeft[i]), maximum), minimum));
+			store(&mixRight[i], Kore::max(Kore::min(Kore::load(&mixRight[i]), maximum), minimum));
+		}
+	}
+
+	void write(float value) {
 		*(float*)&Audio2::buffer.data[Audio2::buffer.writeLocation] = value;
 		Audio2::buffer.writeLocation += 4;
 		if (Audio2::buffer.writeLocation >= Audio2::buffer.dataSize) Audio2::buffer.writeLocation = 0;
 	}
 }
 
-void Audio1::init() {
-	for (int i = 0; i < channelCount; ++i) {
+// Every voice is resampled into a planar block, the blocks are summed and clamped once
+void Audio1::mix(int samples) {
+	int frames = samples / 2;
+	while (frames > 0) {
+		int count = Kore::min(frames, blockSize);
+		mixBlock(count);
+		for (int i = 0; i < count; ++i) {
+			write(mixLeft[i]);
+			write(mixRight[i]);
+		}
+		frames -= count;
+	}
+}
+
+void Audio1::init(int count) {
+	voiceCount = count;
+	channels = new Channel[voiceCount];
+	voices = new MixerVoice[voiceCount];
+	endedGenerations = new std::atomic<u32>[voiceCount];
+	freeChannels.reserve(voiceCount);
+	activeVoices.reserve(voiceCount);
+	for (int i = voiceCount - 1; i >= 0; --i) {
 		channels[i].sound = nullptr;
-		channels[i].position = 0;
+		channels[i].generation = 0;
+		voices[i].sound = nullptr;
+		voices[i].position = 0;
+		voices[i].generation = 0;
+		voices[i].activeIndex = -1;
+		voices[i].decoder = nullptr;
+		endedGenerations[i].store(0);
+		freeChannels.push_back(i);
 	}
-	for (int i = 0; i < channelCount; ++i) {
+	for (int i = 0; i < streamCount; ++i) {
 		streams[i].stream = nullptr;
 		streams[i].position = 0;
+		videos[i].stream = nullptr;
+		videos[i].position = 0;
 	}
-	mutex.create();
+	// enough room for every voice to be started and changed within one block
+	commandCount = voiceCount * 4 + 64;
+	commands = new Command[commandCount];
+	commandRead.store(0);
+	commandWrite.store(0);
+	retiredCount = commandCount + voiceCount + 1;
+	retired = new SoundDecoder*[retiredCount];
+	retiredRead.store(0);
+	retiredWrite.store(0);
 	Audio2::audioCallback = mix;
 }
 
-Audio1::Channel* Audio1::play(Sound* sound, bool loop, float pitch, bool unique) {
-	Channel* channel = nullptr;
-	mutex.lock();
-	bool found = false;
-	for (int i = 0; i < channelCount; ++i) {
-		if (channels[i].sound == sound) {
-			found = true;
-			break;
+Audio1::Voice Audio1::play(Sound* sound, bool loop, float pitch, bool unique, int priority) {
+	collect();
+	Voice voice;
+	voice.index = -1;
+	voice.generation = 0;
+	if (unique) {
+		std::unordered_map<Sound*, int>::iterator first = soundChannels.find(sound);
+		int i = first == soundChannels.end() ? -1 : first->second;
+		while (i >= 0) {
+			int next = channels[i].next;
+			if (active(i)) return voice;
+			release(i);
+			i = next;
 		}
 	}
-	if (!found || !unique) {
-		for (int i = 0; i < channelCount; ++i) {
-			if (channels[i].sound == nullptr) {
-				channels[i].sound = sound;
-				channels[i].position = 0;
-				channels[i].loop = loop;
-				channels[i].pitch = pitch;
-				channels[i].volume = 1.0f;
-				channel = &channels[i];
-				break;
-			}
-		}
+	if (full()) {
+		log(Warning, "Audio1 command queue is full.");
+		return voice;
 	}
-	mutex.unlock();
-	return channel;
+	int i = allocate(priority);
+	if (i < 0) return voice;
+
+	Channel& channel = channels[i];
+	channel.sound = sound;
+	channel.loop = loop;
+	channel.pitch = pitch;
+	channel.volume = 1.0f;
+	channel.priority = priority;
+	++channel.generation;
+	link(i);
+
+	Command play = command(Command::PlaySound);
+	play.channel = i;
+	play.generation = channel.generation;
+	play.sound = sound;
+	if (sound->compressed != nullptr) play.decoder = new SoundDecoder(sound);
+	play.loop = loop;
+	play.value = pitch;
+	push(play);
+
+	voice.index = i;
+	voice.generation = channel.generation;
+	return voice;
 }
 
 void Audio1::stop(Sound* sound) {
-	mutex.lock();
-	for (int i = 0; i < channelCount; ++i) {
-		if (channels[i].sound == sound) {
-			channels[i].sound = nullptr;
-			channels[i].position = 0;
-			break;
-		}
+	collect();
+	std::unordered_map<Sound*, int>::iterator first = soundChannels.find(sound);
+	int i = first == soundChannels.end() ? -1 : first->second;
+	while (i >= 0) {
+		int next = channels[i].next;
+		Voice voice;
+		voice.index = i;
+		voice.generation = channels[i].generation;
+		if (active(i)) stop(voice);
+		else release(i);
+		i = next;
 	}
-	mutex.unlock();
 }
 
-void Audio1::play(SoundStream* stream) {
-	mutex.lock();
+void Audio1::stop(Voice voice) {
+	collect();
+	if (!current(voice)) return;
+	Command stop = command(Command::StopSound);
+	stop.channel = voice.index;
+	stop.generation = voice.generation;
+	if (push(stop)) release(voice.index);
+}
 
-	for (int i = 0; i < channelCount; ++i) {
-		if (streams[i].stream == stream) {
-			streams[i].stream = nullptr;
-			streams[i].position = 0;
-			break;
-		}
-	}
+bool Audio1::playing(Voice voice) {
+	return current(voice);
+}
 
-	for (int i = 0; i < channelCount; ++i) {
-		if (streams[i].stream == nullptr) {
-			streams[i].stream = stream;
-			streams[i].position = 0;
-			break;
-		}
-	}
+void Audio1::setVolume(Voice voice, float volume) {
+	if (!current(voice)) return;
+	Command set = command(Command::SetVolume);
+	set.channel = voice.index;
+	set.generation = voice.generation;
+	set.value = volume;
+	if (push(set)) channels[voice.index].volume = volume;
+}
+
+void Audio1::setPitch(Voice voice, float pitch) {
+	if (!current(voice)) return;
+	Command set = command(Command::SetPitch);
+	set.channel = voice.index;
+	set.generation = voice.generation;
+	set.value = pitch;
+	if (push(set)) channels[voice.index].pitch = pitch;
+}
 
-	mutex.unlock();
+void Audio1::setPriority(Voice voice, int priority) {
+	if (current(voice)) channels[voice.index].priority = priority;
+}
+
+void Audio1::play(SoundStream* stream) {
+	Command play = command(Command::PlayStream);
+	play.stream = stream;
+	push(play);
 }
 
 void Audio1::stop(SoundStream* stream) {
-	mutex.lock();
-	for (int i = 0; i < channelCount; ++i) {
-		if (streams[i].stream == stream) {
-			streams[i].stream = nullptr;
-			streams[i].position = 0;
-			break;
-		}
-	}
-	mutex.unlock();
+	Command stop = command(Command::StopStream);
+	stop.stream = stream;
+	push(stop);
 }
 
 void Audio1::play(VideoSoundStream* stream) {
-	mutex.lock();
-	for (int i = 0; i < channelCount; ++i) {
-		if (videos[i].stream == nullptr) {
-			videos[i].stream = stream;
-			videos[i].position = 0;
-			break;
-		}
-	}
-	mutex.unlock();
+	Command play = command(Command::PlayVideo);
+	play.video = stream;
+	push(play);
 }
 
 void Audio1::stop(VideoSoundStream* stream) {
-	mutex.lock();
-	for (int i = 0; i < channelCount; ++i) {
-		if (videos[i].stream == stream) {
-			videos[i].stream = nullptr;
-			videos[i].position = 0;
-			break;
-		}
-	}
-	mutex.unlock();
+	Command stop = command(Command::StopVideo);
+	stop.video = stream;
+	push(stop);
 }
@@ -7,12 +7,10 @@ namespace Kore {
 	class VideoSoundStream;
 
 	namespace Audio1 {
-		struct Channel {
-			Sound* sound;
-			float position;
-			bool loop;
-			float volume;
-			float pitch;
+		// Refers to one playing sound, it turns stale once the sound ends or its voice is stolen
+		struct Voice {
+			int index;
+			u32 generation;
 		};
 
 		struct StreamChannel {
@@ -25,9 +23,18 @@ namespace Kore {
 			int position;
 		};
 
-		void init();
-		Channel* play(Sound* sound, bool loop = false, float pitch = 1.0f, bool unique = false);
+		// Everything but mix is queued for the mixer and has to be called from one thread
+		void init(int voiceCount = 64);
+		// When all voices are busy the quietest one of the lowest priority not above priority is stolen,
+		// the returned voice is stale when nothing could be stolen or unique finds the sound playing
+		Voice play(Sound* sound, bool loop = false, float pitch = 1.0f, bool unique = false, int priority = 0);
+		// Stops every voice playing sound
 		void stop(Sound* sound);
+		void stop(Voice voice);
+		bool playing(Voice voice);
+		void setVolume(Voice voice, float volume);
+		void setPitch(Voice voice, float pitch);
+		void setPriority(Voice voice, int priority);
 		void play(SoundStream* stream);
 		void stop(SoundStream* stream);
 		void play(VideoSoundStream* stream);
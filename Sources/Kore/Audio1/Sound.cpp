@@ -82,26 +82,38 @@ namespace {
 		}
 	}
 
-	void splitMono8(u8* data, int size, s16* left, s16* right) {
+	void convertMono8(u8* data, int size, s16* samples) {
 		for (int i = 0; i < size; ++i) {
-			left[i] = convert8to16(data[i]);
-			right[i] = convert8to16(data[i]);
+			samples[i] = convert8to16(data[i]);
 		}
 	}
 
-	void splitMono16(s16* data, int size, s16* left, s16* right) {
-		for (int i = 0; i < size; ++i) {
-			left[i] = data[i];
-			right[i] = data[i];
-		}
-	}
+	// Frames decoded at once per voice
+	const int chunkFrames = 1024;
 }
 
-Sound::Sound(const char* filename) : myVolume(1), size(0), left(0), right(0), length(0) {
+Sound::Sound(const char* filename, bool compressed) : myVolume(1), size(0), left(0), right(0), compressed(nullptr), compressedSize(0), length(0) {
 	size_t filenameLength = strlen(filename);
 	u8* data = nullptr;
 
-	if (strncmp(&filename[filenameLength - 4], ".ogg", 4) == 0) {
+	if (compressed && strncmp(&filename[filenameLength - 4], ".ogg", 4) == 0) {
+		FileReader file(filename);
+		compressedSize = file.size();
+		this->compressed = new u8[compressedSize];
+		file.read(this->compressed, compressedSize);
+		stb_vorbis* vorbis = stb_vorbis_open_memory(this->compressed, compressedSize, nullptr, nullptr);
+		affirm(vorbis != nullptr, "Corrupt ogg file: %s", filename);
+		stb_vorbis_info info = stb_vorbis_get_info(vorbis);
+		format.channels = info.channels;
+		format.samplesPerSecond = info.sample_rate;
+		format.bitsPerSample = 16;
+		size = stb_vorbis_stream_length_in_samples(vorbis);
+		length = size / (float)format.samplesPerSecond;
+		stb_vorbis_close(vorbis);
+		sampleRatePos = 44100 / (float)format.samplesPerSecond;
+		return;
+	}
+	else if (strncmp(&filename[filenameLength - 4], ".ogg", 4) == 0) {
 		FileReader file(filename);
 		u8* filedata = (u8*)file.readAll();
 		int samples = stb_vorbis_decode_memory(filedata, file.size(), &format.channels, &format.samplesPerSecond, (short**)&data);
@@ -139,20 +151,20 @@ Sound::Sound(const char* filename) : myVolume(1), size(0), left(0), right(0), le
 	}
 
 	if (format.channels == 1) {
+		// mono is stored once and shared by both channels
 		if (format.bitsPerSample == 8) {
 			left = new s16[size];
-			right = new s16[size];
-			splitMono8(data, size, left, right);
+			convertMono8(data, size, left);
 		}
 		else if (format.bitsPerSample == 16) {
 			size /= 2;
 			left = new s16[size];
-			right = new s16[size];
-			splitMono16((s16*)data, size, left, right);
+			memcpy(left, data, size * 2);
 		}
 		else {
 			assert(false);
 		}
+		right = left;
 	}
 	else {
 		// Left and right channel are in s16 audio stream, alternating.
@@ -177,10 +189,12 @@ Sound::Sound(const char* filename) : myVolume(1), size(0), left(0), right(0), le
 }
 
 Sound::~Sound() {
+	if (right != left) delete[] right;
 	delete[] left;
-	delete[] right;
+	delete[] compressed;
 	left = nullptr;
 	right = nullptr;
+	compressed = nullptr;
 }
 
 float Sound::volume() {
@@ -190,3 +204,53 @@ float Sound::volume() {
 void Sound::setVolume(float value) {
 	myVolume = value;
 }
+
+SoundDecoder::SoundDecoder(Sound* sound) : start(0), length(0) {
+	vorbis = stb_vorbis_open_memory(sound->compressed, sound->compressedSize, nullptr, nullptr);
+	channels = sound->format.channels > 1 ? 2 : 1;
+	buffer = new s16[(chunkFrames + 1) * channels];
+}
+
+SoundDecoder::~SoundDecoder() {
+	if (vorbis != nullptr) stb_vorbis_close(vorbis);
+	delete[] buffer;
+}
+
+// Makes frame and the one after it available in buffer
+bool SoundDecoder::load(int frame) {
+	if (vorbis == nullptr) return false;
+	if (frame < start) {
+		stb_vorbis_seek_start(vorbis);
+		start = 0;
+		length = 0;
+	}
+	else if (frame > start + length + chunkFrames) {
+		stb_vorbis_seek(vorbis, frame);
+		start = frame;
+		length = 0;
+	}
+	while (frame + 1 >= start + length) {
+		// the last frame is kept to interpolate across chunks
+		int kept = length > 0 ? 1 : 0;
+		if (kept > 0) memcpy(buffer, &buffer[(length - 1) * channels], channels * sizeof(s16));
+		start += length - kept;
+		length = kept;
+		int decoded = stb_vorbis_get_samples_short_interleaved(vorbis, channels, &buffer[kept * channels], chunkFrames * channels);
+		if (decoded <= 0) return false;
+		length += decoded;
+	}
+	return true;
+}
+
+void SoundDecoder::sample(float position, float& left, float& right) {
+	int frame = (int)position;
+	if (!load(frame)) {
+		left = right = 0;
+		return;
+	}
+	float a = position - frame;
+	s16* first = &buffer[(frame - start) * channels];
+	s16* second = first + channels;
+	left = (first[0] * (1 - a) + second[0] * a) / 32767.0f;
+	right = channels > 1 ? (first[1] * (1 - a) + second[1] * a) / 32767.0f : left;
+}
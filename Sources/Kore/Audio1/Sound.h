@@ -2,20 +2,43 @@
 
 #include <Kore/Audio2/Audio.h>
 
+struct stb_vorbis;
+
 namespace Kore {
 	struct Sound {
 	public:
-		Sound(const char* filename);
+		// compressed keeps .ogg files encoded in memory, every voice decodes its own copy while playing
+		Sound(const char* filename, bool compressed = false);
 		~Sound();
 		Audio2::BufferFormat format;
 		float volume();
 		void setVolume(float value);
 		s16* left;
-		s16* right;
+		s16* right; // same as left for mono sounds, both are nullptr for compressed sounds
+		u8* compressed;
+		int compressedSize;
 		int size;
 		float sampleRatePos;
 		float length;
 	private:
 		float myVolume;
 	};
+
+	// Decode cursor of one voice playing a compressed sound
+	class SoundDecoder {
+	public:
+		SoundDecoder(Sound* sound);
+		~SoundDecoder();
+		// Interpolates between two frames, decoding is fastest when position only moves forward
+		void sample(float position, float& left, float& right);
+
+	private:
+		bool load(int frame);
+
+		stb_vorbis* vorbis;
+		int channels;
+		s16* buffer;
+		int start;
+		int length;
+	};
 }
@@ -4,26 +4,118 @@
 
 #define STB_VORBIS_HEADER_ONLY
 #include "stb_vorbis.c"
+#include <Kore/Audio2/Audio.h>
 #include <Kore/IO/FileReader.h>
+#include <Kore/Math/Core.h>
+#include <Kore/Threads/Mutex.h>
+#include <Kore/Threads/Thread.h>
+#ifdef KORE_THREADS
+#include <Kore/Threads/Semaphore.h>
+#endif
 #include <string.h>
 
+#include <vector>
+
 using namespace Kore;
 
-SoundStream::SoundStream(const char* filename, bool looping) : decoded(false), myLooping(looping), myVolume(1), rateDecodedHack(false), end(false) {
+namespace {
+	// Output frames buffered per stream, a power of two
+	const u32 ringFrames = 16384;
+	const int chunkFrames = 2048;
+
+	// One thread decodes every stream, Kore threads are never freed
+	bool started = false;
+	Mutex mutex;
+#ifdef KORE_THREADS
+	Semaphore wake;
+	std::vector<SoundStream*> streams;
+
+	void decodeStreams(void*) {
+		for (;;) {
+			mutex.lock();
+			for (unsigned i = 0; i < streams.size(); ++i) streams[i]->_decode();
+			mutex.unlock();
+			wake.tryToAcquire(0.01);
+		}
+	}
+#endif
+
+	void start() {
+		if (started) return;
+		started = true;
+		mutex.create();
+#ifdef KORE_THREADS
+		wake.create(0, 1);
+		createAndRunThread(decodeStreams, nullptr);
+#endif
+	}
+
+	// stb_vorbis takes its scratch memory from the stack unless it gets a buffer,
+	// and Kore threads have small stacks
+	stb_vorbis* open(u8* data, int size, char*& memory) {
+		for (int memorySize = 256 * 1024; memorySize <= 16 * 1024 * 1024; memorySize *= 2) {
+			memory = new char[memorySize];
+			stb_vorbis_alloc alloc;
+			alloc.alloc_buffer = memory;
+			alloc.alloc_buffer_length_in_bytes = memorySize;
+			int error = 0;
+			stb_vorbis* vorbis = stb_vorbis_open_memory(data, size, &error, &alloc);
+			if (vorbis != nullptr) return vorbis;
+			delete[] memory;
+			memory = nullptr;
+			if (error != VORBIS_outofmem) break;
+		}
+		return nullptr;
+	}
+}
+
+SoundStream::SoundStream(const char* filename, bool looping)
+    : decoderMemory(nullptr), myLooping(looping), myVolume(1), sourceLength(0), sourcePosition(0), readPosition(0), writePosition(0), discardPosition(0),
+      played(0), finished(false), rightPending(false), pendingRight(0) {
 	FileReader file(filename);
 	buffer = new u8[file.size()];
-	u8* filecontent = (u8*)file.readAll();
-	memcpy(buffer, filecontent, file.size());
-	vorbis = stb_vorbis_open_memory(buffer, file.size(), nullptr, nullptr);
+	file.read(buffer, file.size());
+	vorbis = open(buffer, file.size(), decoderMemory);
 	if (vorbis != nullptr) {
 		stb_vorbis_info info = stb_vorbis_get_info(vorbis);
 		chans = info.channels;
 		rate = info.sample_rate;
+		streamLength = stb_vorbis_stream_length_in_seconds(vorbis);
 	}
 	else {
 		chans = 2;
 		rate = 22050;
+		streamLength = 0;
+	}
+	step = rate / (float)Audio2::samplesPerSecond;
+	source = new float[(chunkFrames + 1) * 2];
+	ring = new float[ringFrames * 2];
+
+	_decode();
+	start();
+#ifdef KORE_THREADS
+	mutex.lock();
+	streams.push_back(this);
+	mutex.unlock();
+#endif
+}
+
+SoundStream::~SoundStream() {
+#ifdef KORE_THREADS
+	mutex.lock();
+	for (unsigned i = 0; i < streams.size(); ++i) {
+		if (streams[i] == this) {
+			streams.erase(streams.begin() + i);
+			break;
+		}
 	}
+	mutex.unlock();
+#endif
+	if (vorbis != nullptr) stb_vorbis_close(vorbis);
+	delete[] decoderMemory;
+	delete[] buffer;
+	delete[] source;
+	delete[] ring;
 }
 
 int SoundStream::channels() {
@@ -39,7 +131,12 @@ bool SoundStream::looping() {
 }
 
 void SoundStream::setLooping(bool loop) {
+	mutex.lock();
 	myLooping = loop;
+	mutex.unlock();
+#ifdef KORE_THREADS
+	wake.release();
+#endif
 }
 
 float SoundStream::volume() {
@@ -51,64 +148,119 @@ void SoundStream::setVolume(float value) {
 }
 
 bool SoundStream::ended() {
-	return end;
+	return finished.load(std::memory_order_acquire) && readPosition.load(std::memory_order_relaxed) == writePosition.load(std::memory_order_acquire);
 }
 
 float SoundStream::length() {
-	if (vorbis == nullptr) return 0;
-	return stb_vorbis_stream_length_in_seconds(vorbis);
+	return streamLength;
 }
 
 float SoundStream::position() {
-	if (vorbis == nullptr) return 0;
-	return stb_vorbis_get_sample_offset(vorbis) / stb_vorbis_stream_length_in_samples(vorbis) * length();
+	float seconds = played.load(std::memory_order_relaxed) / (float)Audio2::samplesPerSecond;
+	if (myLooping && streamLength > 0) return Kore::mod(seconds, streamLength);
+	return Kore::min(seconds, streamLength);
 }
 
+// Restarts decoding right away, frames that are already buffered are dropped by the next read
 void SoundStream::reset() {
+	mutex.lock();
 	if (vorbis != nullptr) stb_vorbis_seek_start(vorbis);
-	end = false;
-	rateDecodedHack = false;
-	decoded = false;
+	sourceLength = 0;
+	sourcePosition = 0;
+	finished.store(false, std::memory_order_release);
+	discardPosition.store(writePosition.load(std::memory_order_relaxed), std::memory_order_release);
+	_decode();
+	mutex.unlock();
 }
 
-float SoundStream::nextSample() {
-	if (vorbis == nullptr) return 0;
-	if (rate == 22050) {
-		if (rateDecodedHack) {
-			if (decoded) {
-				decoded = false;
-				return samples[0];
-			}
-			else {
-				rateDecodedHack = false;
-				decoded = true;
-				return samples[1];
-			}
-		}
+// Decodes the next chunk behind the last frame of the previous one
+bool SoundStream::decodeChunk() {
+	if (sourceLength > 0) {
+		source[0] = source[(sourceLength - 1) * 2 + 0];
+		source[1] = source[(sourceLength - 1) * 2 + 1];
+		sourcePosition -= sourceLength - 1;
+		sourceLength = 1;
 	}
-	if (decoded) {
-		decoded = false;
-		if (chans == 1) {
-			return samples[0];
-		}
-		else {
-			return samples[1];
+	int decodeChannels = chans > 1 ? 2 : 1;
+	float* target = &source[sourceLength * 2];
+	int decoded = stb_vorbis_get_samples_float_interleaved(vorbis, decodeChannels, target, chunkFrames * decodeChannels);
+	if (decoded == 0 && myLooping) {
+		stb_vorbis_seek_start(vorbis);
+		decoded = stb_vorbis_get_samples_float_interleaved(vorbis, decodeChannels, target, chunkFrames * decodeChannels);
+	}
+	if (decoded == 0) return false;
+	if (decodeChannels == 1) {
+		for (int i = decoded - 1; i >= 0; --i) {
+			target[i * 2 + 0] = target[i];
+			target[i * 2 + 1] = target[i];
 		}
 	}
-	else {
-		int read = stb_vorbis_get_samples_float_interleaved(vorbis, chans, &samples[0], chans);
-		if (read == 0) {
-			if (looping()) {
-				stb_vorbis_seek_start(vorbis);
-				stb_vorbis_get_samples_float_interleaved(vorbis, chans, &samples[0], chans);
-			}
-			else {
-				end = true;
-				return 0.0f;
-			}
+	sourceLength += decoded;
+	return true;
+}
+
+// Resamples linearly from the stream's rate into the ring until it is full
+void SoundStream::_decode() {
+	if (vorbis == nullptr || finished.load(std::memory_order_relaxed)) {
+		finished.store(true, std::memory_order_release);
+		return;
+	}
+	u32 write = writePosition.load(std::memory_order_relaxed);
+	u32 free = ringFrames - (write - readPosition.load(std::memory_order_acquire));
+	while (free > 0) {
+		if (sourcePosition + 1 >= sourceLength && !decodeChunk()) {
+			writePosition.store(write, std::memory_order_release);
+			finished.store(true, std::memory_order_release);
+			return;
 		}
-		decoded = true;
-		rateDecodedHack = true;
-		return samples[0];
+		int frame = (int)sourcePosition;
+		float a = sourcePosition - frame;
+		float* target = &ring[(write & (ringFrames - 1)) * 2];
+		target[0] = source[frame * 2 + 0] * (1 - a) + source[frame * 2 + 2] * a;
+		target[1] = source[frame * 2 + 1] * (1 - a) + source[frame * 2 + 3] * a;
+		sourcePosition += step;
+		++write;
+		--free;
+	}
+	writePosition.store(write, std::memory_order_release);
+}
+
+int SoundStream::read(float* left, float* right, int frames) {
+#ifndef KORE_THREADS
+	// without the decoding thread the ring is topped up chunk by chunk before every read
+	mutex.lock();
+	_decode();
+	mutex.unlock();
+#endif
+	u32 write = writePosition.load(std::memory_order_acquire);
+	u32 discard = discardPosition.load(std::memory_order_acquire);
+	u32 read = readPosition.load(std::memory_order_relaxed);
+	if ((s32)(discard - read) > 0) {
+		read = discard;
+		played.store(0, std::memory_order_relaxed);
+	}
+	int count = (int)Kore::min((u32)frames, write - read);
+	for (int i = 0; i < count; ++i) {
+		const float* frame = &ring[((read + i) & (ringFrames - 1)) * 2];
+		left[i] = frame[0];
+		right[i] = frame[1];
+	}
+	for (int i = count; i < frames; ++i) {
+		left[i] = 0;
+		right[i] = 0;
+	}
+	readPosition.store(read + count, std::memory_order_release);
+	played.store(played.load(std::memory_order_relaxed) + count, std::memory_order_relaxed);
+	return count;
+}
+
+float SoundStream::nextSample() {
+	if (rightPending) {
+		rightPending = false;
+		return pendingRight;
 	}
+	float left;
+	read(&left, &pendingRight, 1);
+	rightPending = true;
+	return left;
 }
@@ -1,12 +1,19 @@
 #pragma once
 
+#include <atomic>
+
 struct stb_vorbis;
 
 namespace Kore {
+	// Decoded ahead on a shared background thread into a ring buffer at the output rate,
+	// the mixer only copies finished frames out of it. Without KORE_THREADS read decodes first.
 	class SoundStream {
 	public:
 		SoundStream(const char* filename, bool looping);
+		~SoundStream();
 		float nextSample();
+		// Copies up to frames frames, missing ones are silent, returns the number copied
+		int read(float* left, float* right, int frames);
 		int channels();
 		int sampleRate();
 		bool looping();
@@ -18,16 +25,34 @@ namespace Kore {
 		float volume();
 		void setVolume(float value);
 
+		// Do not call this, it runs on the stream decoding thread or in read
+		void _decode();
+
 	private:
+		bool decodeChunk();
+
 		stb_vorbis* vorbis;
+		u8* buffer;
+		char* decoderMemory;
 		int chans;
 		int rate;
+		float streamLength;
 		bool myLooping;
 		float myVolume;
-		bool decoded;
-		bool rateDecodedHack;
-		bool end;
-		float samples[2];
-		u8* buffer;
+
+		float* source;
+		int sourceLength;
+		float sourcePosition;
+		float step;
+
+		float* ring;
+		std::atomic<u32> readPosition;
+		std::atomic<u32> writePosition;
+		std::atomic<u32> discardPosition;
+		std::atomic<u32> played;
+		std::atomic<bool> finished;
+
+		bool rightPending;
+		float pendingRight;
 	};
 }
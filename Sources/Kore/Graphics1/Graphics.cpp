@@ -1,13 +1,18 @@
 #include "pch.h"
 
 #include "Graphics.h"
+#include "Pixels.h"
+#include "Rasterizer.h"
 
 #include <Kore/Graphics4/Graphics.h>
 #include <Kore/Graphics4/PipelineState.h>
 #include <Kore/Graphics4/Shader.h>
 #include <Kore/IO/FileReader.h>
-#include <Kore/IO/FileReader.h>
+#include <Kore/Log.h>
+#include <Kore/Math/Core.h>
 #include <limits>
+#include <stdio.h>
+#include <string.h>
 
 using namespace Kore;
 
@@ -20,24 +25,278 @@ namespace {
 	Graphics4::IndexBuffer* ib;
 	Graphics4::Texture* texture;
 	int* image;
+	int stride; // in pixels
 	int w, h;
+	bool headless = false;
+	Graphics1::Rasterizer* rasterizer;
+
+	FILE* recording = nullptr;
+	char recordingPattern[1024];
+	int recordedFrames;
+
+	// Only the area which was written to since the last frame is uploaded,
+	// tracked in the rasterizer's tiles so the bounds change rarely while drawing
+	const int tileShift = Graphics1::Rasterizer::tileShift;
+	const int tileSize = Graphics1::Rasterizer::tileSize;
+	int dirtyLeft, dirtyTop, dirtyRight, dirtyBottom; // in tiles, right and bottom are exclusive
+
+	void markDirty(int x, int y) {
+		int tx = x >> tileShift;
+		int ty = y >> tileShift;
+		if (tx < dirtyLeft) dirtyLeft = tx;
+		if (tx >= dirtyRight) dirtyRight = tx + 1;
+		if (ty < dirtyTop) dirtyTop = ty;
+		if (ty >= dirtyBottom) dirtyBottom = ty + 1;
+	}
+
+	void resetDirty() {
+		dirtyLeft = dirtyTop = std::numeric_limits<int>::max();
+		dirtyRight = dirtyBottom = 0;
+	}
+
+	void uploadDirty() {
+		if (dirtyRight <= dirtyLeft) {
+			texture->unlock(0, 0, 0, 0);
+			return;
+		}
+		int x = dirtyLeft * tileSize;
+		int y = dirtyTop * tileSize;
+		texture->unlock(x, y, Kore::min(dirtyRight * tileSize, w) - x, Kore::min(dirtyBottom * tileSize, h) - y);
+		resetDirty();
+	}
+
+	void markDirty(int left, int top, int right, int bottom) {
+		markDirty(left, top);
+		markDirty(right - 1, bottom - 1);
+	}
+
+	void markDirtyTiles(int left, int top, int right, int bottom) {
+		if (right <= left) return;
+		dirtyLeft = Kore::min(dirtyLeft, left);
+		dirtyTop = Kore::min(dirtyTop, top);
+		dirtyRight = Kore::max(dirtyRight, right);
+		dirtyBottom = Kore::max(dirtyBottom, bottom);
+	}
+
+	bool readableImage(Graphics1::Image* image) {
+		return image->data != nullptr && image->format == Graphics1::Image::RGBA32 && image->compression == Graphics1::ImageCompressionNone;
+	}
+
+	u32* row(int y) {
+		return (u32*)&image[y * stride];
+	}
+
+	u32 crc32(u32 crc, const u8* data, int size) {
+		static u32 table[256];
+		if (table[1] == 0) {
+			for (u32 i = 0; i < 256; ++i) {
+				u32 c = i;
+				for (int k = 0; k < 8; ++k) c = (c & 1) ? 0xedb88320u ^ (c >> 1) : c >> 1;
+				table[i] = c;
+			}
+		}
+		crc = ~crc;
+		for (int i = 0; i < size; ++i) crc = table[(crc ^ data[i]) & 0xff] ^ (crc >> 8);
+		return ~crc;
+	}
+
+	void writeU32BE(u8* to, u32 value) {
+		to[0] = (u8)(value >> 24);
+		to[1] = (u8)(value >> 16);
+		to[2] = (u8)(value >> 8);
+		to[3] = (u8)value;
+	}
+
+	void writeChunk(FILE* file, const char* type, const u8* data, int size) {
+		u8 header[8];
+		writeU32BE(header, size);
+		memcpy(&header[4], type, 4);
+		fwrite(header, 1, 8, file);
+		fwrite(data, 1, size, file);
+		u8 crc[4];
+		writeU32BE(crc, crc32(crc32(0, (const u8*)type, 4), data, size));
+		fwrite(crc, 1, 4, file);
+	}
+
+	// RGB PNG with stored deflate blocks, the framebuffer's alpha has no meaning
+	bool writePng(FILE* file) {
+		static const u8 signature[] = {0x89, 'P', 'N', 'G', '\r', '\n', 0x1a, '\n'};
+		fwrite(signature, 1, 8, file);
+
+		u8 header[13];
+		writeU32BE(&header[0], w);
+		writeU32BE(&header[4], h);
+		header[8] = 8; // bits per channel
+		header[9] = 2; // RGB
+		header[10] = header[11] = header[12] = 0;
+		writeChunk(file, "IHDR", header, 13);
+
+		int lineSize = 1 + w * 3;
+		int rawSize = lineSize * h;
+		int blocks = (rawSize + 65534) / 65535;
+		u8* data = new u8[2 + rawSize + blocks * 5 + 4];
+		u8* raw = new u8[rawSize];
+		for (int y = 0; y < h; ++y) {
+			u8* line = &raw[y * lineSize];
+			const u8* from = (const u8*)&image[y * stride];
+			line[0] = 0; // no filter
+			for (int x = 0; x < w; ++x) {
+				line[1 + x * 3 + 0] = from[x * 4 + 0];
+				line[1 + x * 3 + 1] = from[x * 4 + 1];
+				line[1 + x * 3 + 2] = from[x * 4 + 2];
+			}
+		}
+
+		u8* to = data;
+		*to++ = 0x78;
+		*to++ = 0x01;
+		u32 a = 1, b = 0;
+		for (int offset = 0; offset < rawSize; offset += 65535) {
+			int size = Kore::min(65535, rawSize - offset);
+			*to++ = offset + size == rawSize ? 1 : 0;
+			*to++ = (u8)size;
+			*to++ = (u8)(size >> 8);
+			*to++ = (u8)~size;
+			*to++ = (u8)(~size >> 8);
+			memcpy(to, &raw[offset], size);
+			to += size;
+			for (int i = 0; i < size; ++i) {
+				a = (a + raw[offset + i]) % 65521;
+				b = (b + a) % 65521;
+			}
+		}
+		writeU32BE(to, (b << 16) | a);
+		to += 4;
+
+		writeChunk(file, "IDAT", data, (int)(to - data));
+		writeChunk(file, "IEND", nullptr, 0);
+		delete[] raw;
+		delete[] data;
+		return ferror(file) == 0;
+	}
+
+	bool writeRaw(FILE* file) {
+		for (int y = 0; y < h; ++y) fwrite(&image[y * stride], 4, w, file);
+		return ferror(file) == 0;
+	}
+
+	void recordFrame() {
+		if (recording != nullptr) {
+			writeRaw(recording);
+		}
+		else if (recordingPattern[0] != 0) {
+			char path[1100];
+			snprintf(path, sizeof(path), recordingPattern, recordedFrames);
+			Graphics1::saveFrame(path, Graphics1::PngFrame);
+		}
+		++recordedFrames;
+	}
+
+	// Clips the rectangle to the screen and returns false when nothing is left, sx and sy report how much was cut off on the left and top
+	bool clip(int& x, int& y, int& width, int& height, int& sx, int& sy) {
+		sx = x < 0 ? -x : 0;
+		sy = y < 0 ? -y : 0;
+		x += sx;
+		y += sy;
+		width = Kore::min(width - sx, w - x);
+		height = Kore::min(height - sy, h - y);
+		return width > 0 && height > 0;
+	}
 }
 
 void Graphics1::begin() {
+	if (headless) return;
 	Graphics4::begin();
 	image = (int*)texture->lock();
 }
 
 void Graphics1::setPixel(int x, int y, float red, float green, float blue) {
 	if (x < 0 || x >= w || y < 0 || y >= h) return;
+	if (!rasterizer->empty()) flush();
 	int r = (int)(red * 255);
 	int g = (int)(green * 255);
 	int b = (int)(blue * 255);
-	image[y * texture->texWidth + x] = 0xff << 24 | b << 16 | g << 8 | r;
+	image[y * stride + x] = 0xff << 24 | b << 16 | g << 8 | r;
+	markDirty(x, y);
+}
+
+void Graphics1::fillSpan(int x, int y, int length, uint color) {
+	fillRect(x, y, length, 1, color);
+}
+
+void Graphics1::fillRect(int x, int y, int width, int height, uint color) {
+	int sx, sy;
+	if (!clip(x, y, width, height, sx, sy)) return;
+	flush();
+	u32 pixel = swizzle(color);
+	for (int line = y; line < y + height; ++line) fillRow(&row(line)[x], width, pixel);
+	markDirty(x, y, x + width, y + height);
+}
+
+void Graphics1::setPixels(int x, int y, const uint* pixels, int count) {
+	int height = 1;
+	int sx, sy;
+	if (!clip(x, y, count, height, sx, sy)) return;
+	flush();
+	copyRow(&row(y)[x], &pixels[sx], count, true, false);
+	markDirty(x, y, x + count, y + 1);
+}
+
+void Graphics1::blit(const uint* pixels, int width, int height, int stride, int x, int y, bool blend) {
+	int sx, sy;
+	if (!clip(x, y, width, height, sx, sy)) return;
+	flush();
+	for (int line = 0; line < height; ++line) copyRow(&row(y + line)[x], &pixels[(sy + line) * stride + sx], width, true, blend);
+	markDirty(x, y, x + width, y + height);
+}
+
+void Graphics1::blit(Image* image, int x, int y, bool blend) {
+	if (!readableImage(image)) return;
+	int width = image->width;
+	int height = image->height;
+	int sx, sy;
+	if (!clip(x, y, width, height, sx, sy)) return;
+	flush();
+	const u32* pixels = (const u32*)image->data;
+	for (int line = 0; line < height; ++line) copyRow(&row(y + line)[x], &pixels[(sy + line) * image->width + sx], width, false, blend, true);
+	markDirty(x, y, x + width, y + height);
+}
+
+void Graphics1::fillTriangle(float x0, float y0, float x1, float y1, float x2, float y2, uint color) {
+	rasterizer->fillTriangle(x0, y0, x1, y1, x2, y2, swizzle(color));
+}
+
+void Graphics1::drawImage(Image* image, float x, float y) {
+	drawScaledSubImage(image, 0, 0, image->width, image->height, x, y, (float)image->width, (float)image->height);
+}
+
+void Graphics1::drawScaledSubImage(Image* image, int sx, int sy, int sw, int sh, float dx, float dy, float dw, float dh) {
+	if (!readableImage(image) || sx < 0 || sy < 0 || sx + sw > image->width || sy + sh > image->height) return;
+	rasterizer->drawImage(image, sx, sy, sw, sh, dx, dy, dw, dh);
+}
+
+void Graphics1::flush() {
+	int left, top, right, bottom;
+	rasterizer->render((u32*)image, stride, left, top, right, bottom);
+	markDirtyTiles(left, top, right, bottom);
+}
+
+int Graphics1::threadCount() {
+	return rasterizer->getThreadCount();
+}
+
+void Graphics1::setThreadCount(int count) {
+	rasterizer->setThreadCount(count);
 }
 
 void Graphics1::end() {
-	texture->unlock();
+	flush();
+	recordFrame();
+	if (headless) {
+		resetDirty();
+		return;
+	}
+	uploadDirty();
 
 	Graphics4::clear(Graphics4::ClearColorFlag, 0xff000000);
 
@@ -71,6 +330,7 @@ void Graphics1::init(int width, int height) {
 	tex = pipeline->getTextureUnit("tex");
 
 	texture = new Graphics4::Texture(width, height, Image::RGBA32, false);
+	stride = texture->texWidth;
 	image = (int*)texture->lock();
 	for (int y = 0; y < texture->texHeight; ++y) {
 		for (int x = 0; x < texture->texWidth; ++x) {
@@ -79,6 +339,10 @@ void Graphics1::init(int width, int height) {
 	}
 	texture->unlock();
 
+	resetDirty();
+	delete rasterizer;
+	rasterizer = new Rasterizer(width, height);
+
 	// Correct for the difference between the texture's desired size and the actual power of 2 size
 	float xAspect = (float)texture->width / texture->texWidth;
 	float yAspect = (float)texture->height / texture->texHeight;
@@ -124,6 +388,56 @@ void Graphics1::init(int width, int height) {
 	ib->unlock();
 }
 
+void Graphics1::initHeadless(int width, int height) {
+	w = width;
+	h = height;
+	stride = width;
+	headless = true;
+	image = new int[width * height];
+	for (int i = 0; i < width * height; ++i) image[i] = 0xff000000;
+	resetDirty();
+	delete rasterizer;
+	rasterizer = new Rasterizer(width, height);
+}
+
+const u8* Graphics1::pixels() {
+	return (const u8*)image;
+}
+
+int Graphics1::pixelStride() {
+	return stride;
+}
+
+bool Graphics1::saveFrame(const char* path, FrameFormat format) {
+	FILE* file = fopen(path, "wb");
+	if (file == nullptr) {
+		log(Warning, "Could not open file %s.", path);
+		return false;
+	}
+	bool written = format == PngFrame ? writePng(file) : writeRaw(file);
+	fclose(file);
+	return written;
+}
+
+bool Graphics1::recordFrames(const char* path, FrameFormat format) {
+	stopRecording();
+	recordedFrames = 0;
+	if (format == RawFrame) {
+		recording = fopen(path, "wb");
+		if (recording == nullptr) log(Warning, "Could not open file %s.", path);
+		return recording != nullptr;
+	}
+	strncpy(recordingPattern, path, sizeof(recordingPattern) - 1);
+	recordingPattern[sizeof(recordingPattern) - 1] = 0;
+	return true;
+}
+
+void Graphics1::stopRecording() {
+	if (recording != nullptr) fclose(recording);
+	recording = nullptr;
+	recordingPattern[0] = 0;
+}
+
 int Graphics1::width() {
 	return w;
 }
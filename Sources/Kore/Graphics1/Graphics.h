@@ -1,14 +1,55 @@
 #pragma once
 
 #include <Kore/Graphics1/Color.h>
+#include <Kore/Graphics1/Image.h>
 
 namespace Kore {
 	namespace Graphics1 {
 		void init(int width, int height);
+		// Keeps the framebuffer in memory and never touches Graphics4, for machines without a display
+		void initHeadless(int width, int height);
 		void begin();
 		void end();
 		void setPixel(int x, int y, float red, float green, float blue);
+
+		// Colors are 0xAARRGGBB like Color's constants, everything outside of the screen is clipped.
+		// Colors with alpha below 0xff are blended over the existing pixels.
+		void fillSpan(int x, int y, int length, uint color);
+		void fillRect(int x, int y, int width, int height, uint color);
+		// Copies count pixels into the row y starting at x, alpha is ignored
+		void setPixels(int x, int y, const uint* pixels, int count);
+		// stride is in pixels
+		void blit(const uint* pixels, int width, int height, int stride, int x, int y, bool blend = true);
+		// Image has to be a readable RGBA32 image, its colors are premultiplied by alpha like the loaders produce them
+		void blit(Image* image, int x, int y, bool blend = true);
+
+		// Triangles and images are collected in screen tiles and drawn by several threads in flush or end,
+		// the functions above flush first to keep the order. Images have to be readable RGBA32 images
+		// which stay unchanged until then.
+		void fillTriangle(float x0, float y0, float x1, float y1, float x2, float y2, uint color);
+		void drawImage(Image* image, float x, float y);
+		void drawScaledSubImage(Image* image, int sx, int sy, int sw, int sh, float dx, float dy, float dw, float dh);
+		void flush();
+		// Number of threads drawing tiles including the calling one, 1 by default
+		int threadCount();
+		void setThreadCount(int count);
 		int width();
 		int height();
+
+		enum FrameFormat {
+			RawFrame, // RGBA8 rows without any header, as read by ffmpeg -f rawvideo -pix_fmt rgba
+			PngFrame
+		};
+
+		// The current frame as height() rows of width() RGBA8 pixels, between begin and end or at any time when headless
+		const u8* pixels();
+		// Distance between the rows of pixels() in pixels, in a window it can be larger than width()
+		int pixelStride();
+		// Writes the current frame to a plain file system path
+		bool saveFrame(const char* path, FrameFormat format);
+		// Saves every frame in end(). Raw frames are appended to the file at path, for PNG path is
+		// a printf pattern which receives the frame number, e.g. "frame%05d.png".
+		bool recordFrames(const char* path, FrameFormat format);
+		void stopRecording();
 	}
 }
@@ -13,6 +13,7 @@
 #include <Kore/IO/FileReader.h>
 #include <Kore/IO/Reader.h>
 #include <Kore/Log.h>
+#include <Kore/Simd/uint32x4.h>
 
 #define STB_IMAGE_IMPLEMENTATION
 #include "stb_image.h"
@@ -31,11 +32,48 @@ namespace {
 		return strncmp(str + lenstr - lensuffix, suffix, lensuffix) == 0;
 	}
 
+	bool opaque(const u32* pixels, int count) {
+		uint32x4 all = loadAll(0xffffffffu);
+		int i = 0;
+		for (; i + 4 <= count; i += 4) all = bitAnd(all, load(&pixels[i]));
+		u32 lanes[4];
+		store(lanes, all);
+		u32 alpha = lanes[0] & lanes[1] & lanes[2] & lanes[3];
+		for (; i < count; ++i) alpha &= pixels[i];
+		return (alpha >> 24) == 0xff;
+	}
+
+	// RGBA8 pixels, rounds like round(color * alpha / 255)
+	void premultiply(u32* pixels, int count) {
+		uint32x4 zero = loadAll(0u);
+		uint32x4 alphaMask = loadAll(0xff000000u);
+		uint32x4 colorMask = loadAll(0x00ffffffu);
+		int i = 0;
+		for (; i + 4 <= count; i += 4) {
+			uint32x4 pixel = load(&pixels[i]);
+			uint32x4 alpha = shiftRight(pixel, 24);
+			alpha = bitOr(alpha, shiftLeft(alpha, 8));
+			alpha = bitOr(alpha, shiftLeft(alpha, 16));
+			store(&pixels[i], bitOr(bitAnd(lerpBytes(zero, pixel, alpha), colorMask), bitAnd(pixel, alphaMask)));
+		}
+		for (; i < count; ++i) {
+			u32 pixel = pixels[i];
+			u32 alpha = pixel >> 24;
+			u32 result = pixel & 0xff000000;
+			for (int shift = 0; shift < 24; shift += 8) {
+				u32 value = ((pixel >> shift) & 0xff) * alpha + 128;
+				result |= ((value + (value >> 8)) >> 8) << shift;
+			}
+			pixels[i] = result;
+		}
+	}
+
 	void loadImage(Kore::Reader& file, const char* filename, u8*& output, int& outputSize, int& width, int& height, Graphics1::ImageCompression& compression,
 	               Graphics1::Image::Format& format, unsigned& internalFormat) {
 		format = Graphics1::Image::RGBA32;
 		if (endsWith(filename, "k")) {
-			u8* data = (u8*)file.readAll();
+			// payloads are decompressed straight out of the mapped file
+			u8* data = (u8*)file.map();
 			width = Reader::readS32LE(data + 0);
 			height = Reader::readS32LE(data + 4);
 			char fourcc[5];
@@ -150,35 +188,23 @@ namespace {
 			compression = Graphics1::ImageCompressionPVRTC;
 			internalFormat = 0;
 
-			u8* all = (u8*)file.readAll();
+			const u8* all = (const u8*)file.map();
 			outputSize = ww * hh / 2;
 			output = new u8[outputSize];
-			for (int i = 0; i < outputSize; ++i) {
-				output[i] = all[52 + metaDataSize + i];
-			}
+			memcpy(output, all + 52 + metaDataSize, outputSize);
 		}
 		else if (endsWith(filename, "png")) {
 			int size = file.size();
 			int comp;
 			compression = Graphics1::ImageCompressionNone;
 			internalFormat = 0;
-			output = stbi_load_from_memory((u8*)file.readAll(), size, &width, &height, &comp, 4);
+			output = stbi_load_from_memory((const u8*)file.map(), size, &width, &height, &comp, 4);
 			if (output == nullptr) {
 				log(Error, stbi_failure_reason());
 			}
-			for (int y = 0; y < height; ++y) {
-				for (int x = 0; x < width; ++x) {
-					float r = output[y * width * 4 + x * 4 + 0] / 255.0f;
-					float g = output[y * width * 4 + x * 4 + 1] / 255.0f;
-					float b = output[y * width * 4 + x * 4 + 2] / 255.0f;
-					float a = output[y * width * 4 + x * 4 + 3] / 255.0f;
-					r *= a;
-					g *= a;
-					b *= a;
-					output[y * width * 4 + x * 4 + 0] = (u8)Kore::round(r * 255.0f);
-					output[y * width * 4 + x * 4 + 1] = (u8)Kore::round(g * 255.0f);
-					output[y * width * 4 + x * 4 + 2] = (u8)Kore::round(b * 255.0f);
-				}
+			// grey and RGB files come out opaque
+			else if ((comp == 2 || comp == 4) && !opaque((u32*)output, width * height)) {
+				premultiply((u32*)output, width * height);
 			}
 			outputSize = width * height * 4;
 		}
@@ -187,7 +213,7 @@ namespace {
 			int comp;
 			compression = Graphics1::ImageCompressionNone;
 			internalFormat = 0;
-			output = (u8*)stbi_loadf_from_memory((u8*)file.readAll(), size, &width, &height, &comp, 4);
+			output = (u8*)stbi_loadf_from_memory((const u8*)file.map(), size, &width, &height, &comp, 4);
 			if (output == nullptr) {
 				log(Error, stbi_failure_reason());
 			}
@@ -199,7 +225,7 @@ namespace {
 			int comp;
 			compression = Graphics1::ImageCompressionNone;
 			internalFormat = 0;
-			output = stbi_load_from_memory((u8*)file.readAll(), size, &width, &height, &comp, 4);
+			output = stbi_load_from_memory((const u8*)file.map(), size, &width, &height, &comp, 4);
 			if (output == nullptr) {
 				log(Error, stbi_failure_reason());
 			}
@@ -0,0 +1,154 @@
+#include "pch.h"
+
+#include "ImageLoader.h"
+
+#include <limits>
+
+using namespace Kore;
+
+#ifdef KORE_THREADS
+namespace {
+	// One entry per request, workers take the oldest request of the loader they pop
+	std::deque<Graphics1::ImageLoader*> poolQueue;
+	Mutex poolMutex;
+	Semaphore poolAvailable;
+	bool poolStarted = false;
+}
+#endif
+
+Graphics1::ImageLoader::ImageLoader() : inFlight(0) {
+	mutex.create();
+#ifdef KORE_THREADS
+	decoding = 0;
+	done.create(0, std::numeric_limits<int>::max());
+	if (!poolStarted) {
+		poolStarted = true;
+		poolMutex.create();
+		poolAvailable.create(0, std::numeric_limits<int>::max());
+		for (int i = 0; i < poolThreads; ++i) createAndRunThread(run, nullptr);
+	}
+#endif
+}
+
+// Requests no worker has started on are dropped, decodes in progress are waited for
+Graphics1::ImageLoader::~ImageLoader() {
+#ifdef KORE_THREADS
+	poolMutex.lock();
+	for (std::deque<ImageLoader*>::iterator it = poolQueue.begin(); it != poolQueue.end();) {
+		if (*it == this) it = poolQueue.erase(it);
+		else ++it;
+	}
+	poolMutex.unlock();
+	for (;;) {
+		poolMutex.lock();
+		int count = decoding;
+		poolMutex.unlock();
+		if (count == 0) break;
+		done.acquire();
+	}
+	done.destroy();
+#endif
+	for (unsigned i = 0; i < finished.size(); ++i) delete finished[i].image;
+	mutex.destroy();
+}
+
+void Graphics1::ImageLoader::load(const char* filename, bool readable, Callback callback, void* data) {
+	load(&filename, 1, readable, callback, data);
+}
+
+void Graphics1::ImageLoader::load(const char* const* filenames, int count, bool readable, Callback callback, void* data) {
+	mutex.lock();
+	for (int i = 0; i < count; ++i) {
+		Request request;
+		request.filename = filenames[i];
+		request.readable = readable;
+		request.callback = callback;
+		request.data = data;
+		request.image = nullptr;
+		requests.push_back(request);
+	}
+	inFlight += count;
+	mutex.unlock();
+#ifdef KORE_THREADS
+	poolMutex.lock();
+	for (int i = 0; i < count; ++i) poolQueue.push_back(this);
+	poolMutex.unlock();
+	poolAvailable.release(count);
+#endif
+}
+
+#ifdef KORE_THREADS
+void Graphics1::ImageLoader::run(void*) {
+	for (;;) {
+		poolAvailable.acquire();
+		poolMutex.lock();
+		// the entry was removed by a destroyed loader
+		if (poolQueue.empty()) {
+			poolMutex.unlock();
+			continue;
+		}
+		ImageLoader* loader = poolQueue.front();
+		poolQueue.pop_front();
+		++loader->decoding;
+		poolMutex.unlock();
+
+		loader->mutex.lock();
+		Request request = loader->requests.front();
+		loader->requests.pop_front();
+		loader->mutex.unlock();
+
+		request.image = new Image(request.filename.c_str(), request.readable);
+
+		// done is released under the pool's lock so the destructor can not destroy it in between
+		poolMutex.lock();
+		loader->mutex.lock();
+		loader->finished.push_back(request);
+		loader->mutex.unlock();
+		--loader->decoding;
+		loader->done.release();
+		poolMutex.unlock();
+	}
+}
+#endif
+
+void Graphics1::ImageLoader::update(int max) {
+	std::vector<Request> delivered;
+	mutex.lock();
+#ifndef KORE_THREADS
+	while (!requests.empty() && (max < 0 || static_cast<int>(finished.size()) < max)) {
+		Request request = requests.front();
+		requests.pop_front();
+		request.image = new Image(request.filename.c_str(), request.readable);
+		finished.push_back(request);
+	}
+#endif
+	while (!finished.empty() && (max < 0 || static_cast<int>(delivered.size()) < max)) {
+		delivered.push_back(finished.front());
+		finished.pop_front();
+	}
+	mutex.unlock();
+
+	// callbacks run without the lock so they can request more images
+	for (unsigned i = 0; i < delivered.size(); ++i) {
+		mutex.lock();
+		--inFlight;
+		mutex.unlock();
+		delivered[i].callback(delivered[i].filename.c_str(), delivered[i].image, delivered[i].data);
+	}
+}
+
+int Graphics1::ImageLoader::pending() {
+	mutex.lock();
+	int count = inFlight;
+	mutex.unlock();
+	return count;
+}
+
+void Graphics1::ImageLoader::finish() {
+	while (pending() > 0) {
+#ifdef KORE_THREADS
+		done.acquire();
+#endif
+		update();
+	}
+}
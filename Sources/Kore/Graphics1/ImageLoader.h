@@ -0,0 +1,60 @@
+#pragma once
+
+#include <Kore/Graphics1/Image.h>
+#include <Kore/Threads/Mutex.h>
+#include <Kore/Threads/Thread.h>
+#ifdef KORE_THREADS
+#include <Kore/Threads/Semaphore.h>
+#endif
+
+#include <deque>
+#include <string>
+#include <vector>
+
+namespace Kore {
+	namespace Graphics1 {
+		// Reads and decodes images on a pool of worker threads which all loaders share. Finished images are
+		// handed to their callbacks in update, on the thread calling it, which then owns them.
+		// Without KORE_THREADS the images are decoded in update instead.
+		class ImageLoader {
+		public:
+			typedef void (*Callback)(const char* filename, Image* image, void* data);
+
+			// Kore threads are never freed, the pool is started by the first loader and keeps running
+			static const int poolThreads = 2;
+
+			// Loaders have to be created on one thread
+			ImageLoader();
+			~ImageLoader();
+
+			void load(const char* filename, bool readable, Callback callback, void* data = nullptr);
+			void load(const char* const* filenames, int count, bool readable, Callback callback, void* data = nullptr);
+			// Calls the callbacks of at most max finished images, a negative max delivers all of them
+			void update(int max = -1);
+			// Images which were requested but not delivered yet
+			int pending();
+			// Blocks until every requested image was delivered
+			void finish();
+
+		private:
+			struct Request {
+				std::string filename;
+				bool readable;
+				Callback callback;
+				void* data;
+				Image* image;
+			};
+
+			std::deque<Request> requests;
+			std::deque<Request> finished;
+			int inFlight;
+			Mutex mutex;
+#ifdef KORE_THREADS
+			static void run(void* param);
+
+			int decoding; // guarded by the pool's mutex
+			Semaphore done;
+#endif
+		};
+	}
+}
@@ -0,0 +1,85 @@
+#pragma once
+
+#include <Kore/Simd/uint32x4.h>
+
+// Row helpers shared by Graphics1's drawing functions and its rasterizer
+namespace Kore {
+	namespace Graphics1 {
+		// The framebuffer stores 0xAABBGGRR
+		inline u32 swizzle(u32 color) {
+			return (color & 0xff00ff00) | ((color >> 16) & 0xff) | ((color & 0xff) << 16);
+		}
+
+		inline uint32x4 swizzle(uint32x4 color) {
+			uint32x4 ga = bitAnd(color, loadAll(0xff00ff00u));
+			uint32x4 r = bitAnd(shiftRight(color, 16), loadAll(0xffu));
+			uint32x4 b = shiftLeft(bitAnd(color, loadAll(0xffu)), 16);
+			return bitOr(ga, bitOr(r, b));
+		}
+
+		inline u32 blend(u32 destination, u32 source) {
+			u32 alpha = source >> 24;
+			u32 result = 0xff000000;
+			for (int shift = 0; shift < 24; shift += 8) {
+				u32 mixed = ((destination >> shift) & 0xff) * (255 - alpha) + ((source >> shift) & 0xff) * alpha + 128;
+				result |= ((mixed + (mixed >> 8)) >> 8) << shift;
+			}
+			return result;
+		}
+
+		inline uint32x4 blend(uint32x4 destination, uint32x4 source) {
+			uint32x4 alpha = shiftRight(source, 24);
+			alpha = bitOr(alpha, shiftLeft(alpha, 8));
+			alpha = bitOr(alpha, shiftLeft(alpha, 16));
+			return bitOr(lerpBytes(destination, source, alpha), loadAll(0xff000000u));
+		}
+
+		// For sources which are already multiplied by their alpha like loaded images, source + destination * (1 - alpha)
+		inline u32 blendPremultiplied(u32 destination, u32 source) {
+			u32 alpha = source >> 24;
+			u32 result = 0xff000000;
+			for (int shift = 0; shift < 24; shift += 8) {
+				u32 scaled = ((destination >> shift) & 0xff) * (255 - alpha) + 128;
+				u32 mixed = ((scaled + (scaled >> 8)) >> 8) + ((source >> shift) & 0xff);
+				result |= (mixed > 255 ? 255 : mixed) << shift;
+			}
+			return result;
+		}
+
+		inline uint32x4 blendPremultiplied(uint32x4 destination, uint32x4 source) {
+			uint32x4 alpha = shiftRight(source, 24);
+			alpha = bitOr(alpha, shiftLeft(alpha, 8));
+			alpha = bitOr(alpha, shiftLeft(alpha, 16));
+			return bitOr(addBytes(lerpBytes(destination, loadAll(0u), alpha), source), loadAll(0xff000000u));
+		}
+
+		// Writes count pixels, swizzling 0xAARRGGBB sources and blending when asked to
+		inline void copyRow(u32* to, const u32* from, int count, bool argb, bool blended, bool premultiplied = false) {
+			int i = 0;
+			for (; i + 4 <= count; i += 4) {
+				uint32x4 source = load(&from[i]);
+				if (argb) source = swizzle(source);
+				if (blended) source = premultiplied ? blendPremultiplied(load(&to[i]), source) : blend(load(&to[i]), source);
+				store(&to[i], source);
+			}
+			for (; i < count; ++i) {
+				u32 source = argb ? swizzle(from[i]) : from[i];
+				if (blended) source = premultiplied ? blendPremultiplied(to[i], source) : blend(to[i], source);
+				to[i] = source;
+			}
+		}
+
+		inline void fillRow(u32* to, int count, u32 color) {
+			uint32x4 colors = loadAll(color);
+			int i = 0;
+			if ((color >> 24) == 0xff) {
+				for (; i + 4 <= count; i += 4) store(&to[i], colors);
+				for (; i < count; ++i) to[i] = color;
+			}
+			else {
+				for (; i + 4 <= count; i += 4) store(&to[i], blend(load(&to[i]), colors));
+				for (; i < count; ++i) to[i] = blend(to[i], color);
+			}
+		}
+	}
+}
@@ -0,0 +1,265 @@
+#include "pch.h"
+
+#include "Rasterizer.h"
+#include "Pixels.h"
+
+#include <Kore/Math/Core.h>
+#ifdef KORE_THREADS
+#include <Kore/Threads/Semaphore.h>
+#endif
+
+#include <limits>
+
+using namespace Kore;
+
+namespace {
+	float edge(float ax, float ay, float bx, float by, float px, float py) {
+		return (bx - ax) * (py - ay) - (by - ay) * (px - ax);
+	}
+
+	// Pixels exactly on an edge belong to only one of the two triangles sharing it
+	bool ownsEdge(float ax, float ay, float bx, float by) {
+		return by > ay || (by == ay && bx < ax);
+	}
+
+	int pixelStart(float position) {
+		return Kore::roundUp(position - 0.5f);
+	}
+
+#ifdef KORE_THREADS
+	// Kore threads are never freed, so the workers are started once and shared by every rasterizer.
+	// Each one waits on its own semaphore and is woken exactly once per render.
+	const int maxWorkers = Graphics1::Rasterizer::maxThreads - 1;
+	Semaphore workerStart[maxWorkers];
+	Semaphore workersDone;
+	bool workersCreated = false;
+	int startedWorkers = 0;
+	Graphics1::Rasterizer* rendering = nullptr;
+#endif
+}
+
+Graphics1::Rasterizer::Rasterizer(int width, int height)
+    : width(width), height(height), threadCount(1), activeThreads(1), pixels(nullptr), stride(0) {
+	tilesX = (width + tileSize - 1) / tileSize;
+	tilesY = (height + tileSize - 1) / tileSize;
+	bins.resize(tilesX * tilesY);
+}
+
+Graphics1::Rasterizer::~Rasterizer() {}
+
+int Graphics1::Rasterizer::getThreadCount() const {
+	return threadCount;
+}
+
+void Graphics1::Rasterizer::setThreadCount(int count) {
+	threadCount = Kore::max(1, Kore::min(count, maxThreads));
+}
+
+void Graphics1::Rasterizer::fillTriangle(float x0, float y0, float x1, float y1, float x2, float y2, u32 color) {
+	Primitive primitive;
+	primitive.type = Primitive::Triangle;
+	primitive.color = color;
+	// every edge function has to be positive inside
+	if (edge(x0, y0, x1, y1, x2, y2) < 0) {
+		float x = x1;
+		float y = y1;
+		x1 = x2;
+		y1 = y2;
+		x2 = x;
+		y2 = y;
+	}
+	primitive.x[0] = x0;
+	primitive.y[0] = y0;
+	primitive.x[1] = x1;
+	primitive.y[1] = y1;
+	primitive.x[2] = x2;
+	primitive.y[2] = y2;
+	primitive.left = pixelStart(Kore::min(x0, Kore::min(x1, x2)));
+	primitive.top = pixelStart(Kore::min(y0, Kore::min(y1, y2)));
+	primitive.right = pixelStart(Kore::max(x0, Kore::max(x1, x2))) + 1;
+	primitive.bottom = pixelStart(Kore::max(y0, Kore::max(y1, y2))) + 1;
+	add(primitive);
+}
+
+void Graphics1::Rasterizer::drawImage(Image* image, int sx, int sy, int sw, int sh, float dx, float dy, float dw, float dh) {
+	if (sw <= 0 || sh <= 0 || dw <= 0 || dh <= 0) return;
+	Primitive primitive;
+	primitive.type = Primitive::Sprite;
+	primitive.image = image;
+	primitive.sx = sx;
+	primitive.sy = sy;
+	primitive.sw = sw;
+	primitive.sh = sh;
+	primitive.dx = dx;
+	primitive.dy = dy;
+	primitive.dw = dw;
+	primitive.dh = dh;
+	primitive.left = pixelStart(dx);
+	primitive.top = pixelStart(dy);
+	primitive.right = pixelStart(dx + dw);
+	primitive.bottom = pixelStart(dy + dh);
+	add(primitive);
+}
+
+void Graphics1::Rasterizer::add(Primitive& primitive) {
+	primitive.left = Kore::max(primitive.left, 0);
+	primitive.top = Kore::max(primitive.top, 0);
+	primitive.right = Kore::min(primitive.right, width);
+	primitive.bottom = Kore::min(primitive.bottom, height);
+	if (primitive.right <= primitive.left || primitive.bottom <= primitive.top) return;
+
+	int index = static_cast<int>(primitives.size());
+	primitives.push_back(primitive);
+	int lastX = (primitive.right - 1) >> tileShift;
+	int lastY = (primitive.bottom - 1) >> tileShift;
+	for (int ty = primitive.top >> tileShift; ty <= lastY; ++ty) {
+		for (int tx = primitive.left >> tileShift; tx <= lastX; ++tx) {
+			std::vector<int>& bin = bins[ty * tilesX + tx];
+			if (bin.empty()) usedTiles.push_back(ty * tilesX + tx);
+			bin.push_back(index);
+		}
+	}
+}
+
+bool Graphics1::Rasterizer::empty() const {
+	return primitives.empty();
+}
+
+void Graphics1::Rasterizer::render(u32* pixels, int stride, int& left, int& top, int& right, int& bottom) {
+	left = top = std::numeric_limits<int>::max();
+	right = bottom = 0;
+	if (primitives.empty()) return;
+
+	for (unsigned i = 0; i < usedTiles.size(); ++i) {
+		int tx = usedTiles[i] % tilesX;
+		int ty = usedTiles[i] / tilesX;
+		left = Kore::min(left, tx);
+		top = Kore::min(top, ty);
+		right = Kore::max(right, tx + 1);
+		bottom = Kore::max(bottom, ty + 1);
+	}
+
+	this->pixels = pixels;
+	this->stride = stride;
+	activeThreads = Kore::min(threadCount, static_cast<int>(usedTiles.size()));
+#ifdef KORE_THREADS
+	if (!workersCreated) {
+		workersCreated = true;
+		workersDone.create(0, maxWorkers);
+	}
+	while (startedWorkers < activeThreads - 1) {
+		workerStart[startedWorkers].create(0, 1);
+		// no thread slot left, the tiles are dealt out to the workers there are
+		if (createAndRunThread(run, reinterpret_cast<void*>(static_cast<spint>(startedWorkers + 1))) == nullptr) {
+			workerStart[startedWorkers].destroy();
+			activeThreads = startedWorkers + 1;
+			break;
+		}
+		++startedWorkers;
+	}
+
+	rendering = this;
+	for (int i = 0; i < activeThreads - 1; ++i) workerStart[i].release();
+	work(0);
+	for (int i = 0; i < activeThreads - 1; ++i) workersDone.acquire();
+#else
+	work(0);
+#endif
+
+	for (unsigned i = 0; i < usedTiles.size(); ++i) bins[usedTiles[i]].clear();
+	usedTiles.clear();
+	primitives.clear();
+}
+
+#ifdef KORE_THREADS
+void Graphics1::Rasterizer::run(void* param) {
+	int index = static_cast<int>(reinterpret_cast<spint>(param));
+	for (;;) {
+		workerStart[index - 1].acquire();
+		rendering->work(index);
+		workersDone.release();
+	}
+}
+#endif
+
+// Tiles are dealt out round robin, neighbouring tiles tend to cost the same
+void Graphics1::Rasterizer::work(int thread) {
+	if (thread >= activeThreads) return;
+	for (int i = thread; i < static_cast<int>(usedTiles.size()); i += activeThreads) drawTile(usedTiles[i]);
+}
+
+void Graphics1::Rasterizer::drawTile(int tile) {
+	int tileLeft = (tile % tilesX) * tileSize;
+	int tileTop = (tile / tilesX) * tileSize;
+	const std::vector<int>& bin = bins[tile];
+	for (unsigned i = 0; i < bin.size(); ++i) {
+		const Primitive& primitive = primitives[bin[i]];
+		int left = Kore::max(primitive.left, tileLeft);
+		int top = Kore::max(primitive.top, tileTop);
+		int right = Kore::min(primitive.right, tileLeft + tileSize);
+		int bottom = Kore::min(primitive.bottom, tileTop + tileSize);
+		if (primitive.type == Primitive::Triangle) drawTriangle(primitive, left, top, right, bottom);
+		else drawSprite(primitive, left, top, right, bottom);
+	}
+}
+
+// Triangles are convex, so every row is a single span which is filled four pixels at a time
+void Graphics1::Rasterizer::drawTriangle(const Primitive& p, int left, int top, int right, int bottom) {
+	float stepX[3], stepY[3];
+	bool owned[3];
+	float rowStart[3];
+	for (int i = 0; i < 3; ++i) {
+		int j = (i + 1) % 3;
+		stepX[i] = -(p.y[j] - p.y[i]);
+		stepY[i] = p.x[j] - p.x[i];
+		owned[i] = ownsEdge(p.x[i], p.y[i], p.x[j], p.y[j]);
+		rowStart[i] = edge(p.x[i], p.y[i], p.x[j], p.y[j], left + 0.5f, top + 0.5f);
+	}
+
+	for (int y = top; y < bottom; ++y) {
+		float e[3] = {rowStart[0], rowStart[1], rowStart[2]};
+		int spanStart = -1;
+		int spanEnd = right;
+		for (int x = left; x < right; ++x) {
+			bool inside = (e[0] > 0 || (e[0] == 0 && owned[0])) && (e[1] > 0 || (e[1] == 0 && owned[1])) && (e[2] > 0 || (e[2] == 0 && owned[2]));
+			if (inside && spanStart < 0) spanStart = x;
+			else if (!inside && spanStart >= 0) {
+				spanEnd = x;
+				break;
+			}
+			e[0] += stepX[0];
+			e[1] += stepX[1];
+			e[2] += stepX[2];
+		}
+		if (spanStart >= 0) fillRow(&pixels[y * stride + spanStart], spanEnd - spanStart, p.color);
+		rowStart[0] += stepY[0];
+		rowStart[1] += stepY[1];
+		rowStart[2] += stepY[2];
+	}
+}
+
+// Nearest neighbour sampling, unscaled sprites on whole pixels are copied row by row
+void Graphics1::Rasterizer::drawSprite(const Primitive& p, int left, int top, int right, int bottom) {
+	const u32* source = reinterpret_cast<const u32*>(p.image->data);
+	int sourceStride = p.image->width;
+	if (p.dw == p.sw && p.dh == p.sh && p.dx == (int)p.dx && p.dy == (int)p.dy) {
+		int offsetX = p.sx - (int)p.dx;
+		int offsetY = p.sy - (int)p.dy;
+		for (int y = top; y < bottom; ++y) {
+			copyRow(&pixels[y * stride + left], &source[(y + offsetY) * sourceStride + left + offsetX], right - left, false, true, true);
+		}
+		return;
+	}
+
+	float scaleX = p.sw / p.dw;
+	float scaleY = p.sh / p.dh;
+	for (int y = top; y < bottom; ++y) {
+		int v = p.sy + Kore::min((int)((y + 0.5f - p.dy) * scaleY), p.sh - 1);
+		const u32* from = &source[v * sourceStride];
+		u32* to = &pixels[y * stride];
+		for (int x = left; x < right; ++x) {
+			int u = p.sx + Kore::min((int)((x + 0.5f - p.dx) * scaleX), p.sw - 1);
+			to[x] = blendPremultiplied(to[x], from[u]);
+		}
+	}
+}
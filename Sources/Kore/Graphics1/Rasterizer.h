@@ -0,0 +1,75 @@
+#pragma once
+
+#include <Kore/Graphics1/Image.h>
+#include <Kore/Threads/Thread.h>
+
+#include <vector>
+
+namespace Kore {
+	namespace Graphics1 {
+		// Collects triangles and sprites in screen tiles and rasterizes the tiles
+		// in parallel, every tile keeps the order the primitives were added in.
+		// The worker threads are shared by all rasterizers, so render has to be called from one thread.
+		// Without KORE_THREADS all tiles are drawn by the calling thread.
+		class Rasterizer {
+		public:
+			static const int tileShift = 5;
+			static const int tileSize = 1 << tileShift;
+#ifdef KORE_THREADS
+			static const int maxThreads = MAX_THREADS / 2; // Kore threads are never freed, so only a few are taken
+#else
+			static const int maxThreads = 1;
+#endif
+
+			Rasterizer(int width, int height);
+			~Rasterizer();
+
+			// Number of threads drawing tiles including the calling one
+			int getThreadCount() const;
+			void setThreadCount(int count);
+
+			// color is in the framebuffer's 0xAABBGGRR layout
+			void fillTriangle(float x0, float y0, float x1, float y1, float x2, float y2, u32 color);
+			// image has to stay alive and unchanged until the next render
+			void drawImage(Image* image, int sx, int sy, int sw, int sh, float dx, float dy, float dw, float dh);
+
+			bool empty() const;
+			// Draws everything queued into pixels and reports the touched tiles, right and bottom are exclusive
+			void render(u32* pixels, int stride, int& left, int& top, int& right, int& bottom);
+
+		private:
+			struct Primitive {
+				enum Type { Triangle, Sprite };
+
+				Type type;
+				u32 color;
+				float x[3], y[3];
+				Image* image;
+				int sx, sy, sw, sh;
+				float dx, dy, dw, dh;
+				int left, top, right, bottom; // covered pixels, right and bottom are exclusive
+			};
+
+#ifdef KORE_THREADS
+			static void run(void* index);
+#endif
+			void work(int thread);
+			void add(Primitive& primitive);
+			void drawTile(int tile);
+			void drawTriangle(const Primitive& primitive, int left, int top, int right, int bottom);
+			void drawSprite(const Primitive& primitive, int left, int top, int right, int bottom);
+
+			int width, height;
+			int tilesX, tilesY;
+			std::vector<Primitive> primitives;
+			std::vector<std::vector<int>> bins;
+			std::vector<int> usedTiles;
+
+			int threadCount;
+			int activeThreads;
+
+			u32* pixels;
+			int stride;
+		};
+	}
+}
@@ -4,19 +4,225 @@
 
 #include <Kore/Graphics3/Graphics.h>
 #include <Kore/IO/FileReader.h>
+#include <Kore/Math/Core.h>
 #include <Kore/Simd/float32x4.h>
 
+#include <algorithm>
 #include <string.h>
 
 using namespace Kore;
 
 #ifdef KORE_G4
 
+namespace {
+	// Every painter streams its batches through a vertex buffer which holds this many batches.
+	// Each flush appends behind the previous one and only wraps around (discarding the old
+	// contents) once the remaining space can not hold a complete batch anymore.
+	const int streamBatches = 4;
+
+	void initQuadIndices(Graphics4::IndexBuffer* indexBuffer, int quads) {
+		int* indices = indexBuffer->lock();
+		for (int i = 0; i < quads; ++i) {
+			indices[i * 3 * 2 + 0] = i * 4 + 0;
+			indices[i * 3 * 2 + 1] = i * 4 + 1;
+			indices[i * 3 * 2 + 2] = i * 4 + 2;
+			indices[i * 3 * 2 + 3] = i * 4 + 0;
+			indices[i * 3 * 2 + 4] = i * 4 + 2;
+			indices[i * 3 * 2 + 5] = i * 4 + 3;
+		}
+		indexBuffer->unlock();
+	}
+
+	// Vertex counts have to stay below 65536 for the 16 bit index buffers on Android and Raspberry Pi
+	const int maxBufferSize = 65536 / (4 * streamBatches);
+
+	int clampBufferSize(int size) {
+		return Kore::clamp(size, 2, maxBufferSize);
+	}
+
+	// Sums up the quads of consecutive batches which were only split because the buffer was full
+	void countFlush(Graphics2::BatchStats& stats, int& runLength, int& peakRunLength, int used, bool full) {
+		runLength += used;
+		if (runLength > peakRunLength) peakRunLength = runLength;
+		if (full) {
+			++stats.capacityFlushes;
+		}
+		else {
+			++stats.stateFlushes;
+			runLength = 0;
+		}
+	}
+
+	// Doubles a buffer size until the longest observed run fits into one batch
+	int grownBufferSize(int size, int peakRunLength) {
+		while (size <= peakRunLength && size < maxBufferSize) size *= 2;
+		return clampBufferSize(size);
+	}
+
+	int nextBatchStart(int start, int used, int batchSize) {
+		start += used;
+		if (start + batchSize > batchSize * streamBatches) start = 0;
+		return start;
+	}
+
+	// Wrapping around locks the whole buffer, which lets the backends discard its old storage
+	float* lockBatch(Graphics4::VertexBuffer* buffer, int start, int count) {
+		return start == 0 ? buffer->lock() : buffer->lock(start, count);
+	}
+
+	// Parks the active buffer of a painter and continues with the one of the new layout,
+	// which is only created when that layout is used for the first time
+	void switchStream(Graphics2::VertexStream* streams, int from, int to, Graphics4::VertexBuffer*& buffer, float*& vertices, int& start,
+	                  Graphics4::VertexStructure& structure, int batchVertices) {
+		streams[from].vertices = vertices;
+		streams[from].start = start;
+		Graphics2::VertexStream& next = streams[to];
+		if (next.buffer == nullptr) {
+			next.buffer = new Graphics4::VertexBuffer(batchVertices * streamBatches, structure, Graphics4::DynamicUsage);
+			next.vertices = lockBatch(next.buffer, 0, batchVertices);
+			next.start = 0;
+		}
+		buffer = next.buffer;
+		vertices = next.vertices;
+		start = next.start;
+	}
+
+	void deleteStreams(Graphics2::VertexStream* streams, int count) {
+		for (int i = 0; i < count; ++i) {
+			delete streams[i].buffer;
+			streams[i] = Graphics2::VertexStream();
+		}
+	}
+
+	// The built-in pipelines read a compact vertex layout - a float2 position, short2norm texture
+	// coordinates and four normalized color bytes - which are written as single 32 bit words.
+	// Custom pipelines keep receiving the regular all-float layout.
+	u32 packColor(uint color, float alpha) {
+		u32 packed;
+		u8* bytes = (u8*)&packed;
+		bytes[0] = (color >> 16) & 0xff;
+		bytes[1] = (color >> 8) & 0xff;
+		bytes[2] = color & 0xff;
+		bytes[3] = static_cast<u8>(Kore::clamp(alpha, 0.0f, 1.0f) * 255.0f + 0.5f);
+		return packed;
+	}
+
+	s16 packTexCoord(float value) {
+		return static_cast<s16>(Kore::round(Kore::clamp(value, -1.0f, 1.0f) * 32767.0f));
+	}
+
+	u32 packTexCoords(float u, float v) {
+		u32 packed;
+		s16* shorts = (s16*)&packed;
+		shorts[0] = packTexCoord(u);
+		shorts[1] = packTexCoord(v);
+		return packed;
+	}
+
+	// Transforms the corners of a rectangle in bottom-left, top-left, top-right, bottom-right order
+	void transformQuad(const mat3& m, float left, float top, float right, float bottom, float* xs, float* ys) {
+		float32x4 xx = load(left, left, right, right);
+		float32x4 yy = load(bottom, top, top, bottom);
+
+		float32x4 px = add(add(mul(loadAll(m.get(0, 0)), xx), mul(loadAll(m.get(0, 1)), yy)), loadAll(m.get(0, 2)));
+		float32x4 py = add(add(mul(loadAll(m.get(1, 0)), xx), mul(loadAll(m.get(1, 1)), yy)), loadAll(m.get(1, 2)));
+		// the division is only needed for projective transformations
+		if (m.get(2, 0) != 0.0f || m.get(2, 1) != 0.0f || m.get(2, 2) != 1.0f) {
+			float32x4 w = add(add(mul(loadAll(m.get(2, 0)), xx), mul(loadAll(m.get(2, 1)), yy)), loadAll(m.get(2, 2)));
+			px = div(px, w);
+			py = div(py, w);
+		}
+
+		store(xs, px);
+		store(ys, py);
+	}
+
+	// FNV-1a
+	u32 hashBytes(u32 hash, const void* data, int size) {
+		const u8* bytes = (const u8*)data;
+		for (int i = 0; i < size; ++i) {
+			hash ^= bytes[i];
+			hash *= 16777619u;
+		}
+		return hash;
+	}
+
+	// Vertex writers shared by the painters, compact selects the packed layout
+	void setPositions(float* vertices, int vertexSize, bool compact, const float* positions, int count) {
+		for (int i = 0; i < count; ++i) {
+			vertices[vertexSize * i + 0] = positions[i * 2 + 0];
+			vertices[vertexSize * i + 1] = positions[i * 2 + 1];
+			if (!compact) vertices[vertexSize * i + 2] = -5.0f; // TODO: should be 0?
+		}
+	}
+
+	// Writes the quad corners of a destination rectangle directly into the mapped vertices
+	void setTransformedPositions(float* vertices, int vertexSize, bool compact, const mat3& transformation, float x, float y, float width, float height) {
+		float xs[4], ys[4];
+		transformQuad(transformation, x, y, x + width, y + height, xs, ys);
+		for (int i = 0; i < 4; ++i) {
+			vertices[vertexSize * i + 0] = xs[i];
+			vertices[vertexSize * i + 1] = ys[i];
+			if (!compact) vertices[vertexSize * i + 2] = -5.0f;
+		}
+	}
+
+	// Texture coordinates of a quad in bottom-left, top-left, top-right, bottom-right order
+	void setTexCoords(float* vertices, int vertexSize, bool compact, float left, float top, float right, float bottom) {
+		if (compact) {
+			u32* words = (u32*)vertices;
+			words[2] = packTexCoords(left, bottom);
+			words[vertexSize + 2] = packTexCoords(left, top);
+			words[vertexSize * 2 + 2] = packTexCoords(right, top);
+			words[vertexSize * 3 + 2] = packTexCoords(right, bottom);
+			return;
+		}
+
+		vertices[3] = left;
+		vertices[4] = bottom;
+
+		vertices[vertexSize + 3] = left;
+		vertices[vertexSize + 4] = top;
+
+		vertices[vertexSize * 2 + 3] = right;
+		vertices[vertexSize * 2 + 4] = top;
+
+		vertices[vertexSize * 3 + 3] = right;
+		vertices[vertexSize * 3 + 4] = bottom;
+	}
+
+	void setColors(float* vertices, int vertexSize, bool compact, int colorOffset, uint color, float alpha, int count) {
+		if (compact) {
+			u32* words = (u32*)vertices;
+			u32 packed = packColor(color, alpha);
+			for (int i = 0; i < count; ++i) words[vertexSize * i + colorOffset] = packed;
+			return;
+		}
+		Graphics1::Color c(color);
+		for (int i = 0; i < count; ++i) {
+			vertices[vertexSize * i + colorOffset + 0] = c.R;
+			vertices[vertexSize * i + colorOffset + 1] = c.G;
+			vertices[vertexSize * i + colorOffset + 2] = c.B;
+			vertices[vertexSize * i + colorOffset + 3] = alpha;
+		}
+	}
+
+	void addCompactStructure(Graphics4::VertexStructure& structure, bool texCoords) {
+		structure.add("vertexPosition", Graphics4::Float2VertexData);
+		if (texCoords) structure.add("texPosition", Graphics4::Short2NormVertexData);
+		structure.add("vertexColor", Graphics4::Byte4NormVertexData);
+	}
+}
+
 //==========
 // ImageShaderPainter
 //==========
-Graphics2::ImageShaderPainter::ImageShaderPainter()
-    : bufferSize(1500), bufferIndex(0), vertexSize(9), bilinear(false), bilinearMipmaps(false), shaderPipeline(nullptr), lastTexture(nullptr), lastRenderTarget(nullptr), myPipeline(nullptr) {
+Graphics2::ImageShaderPainter::ImageShaderPainter(int bufferSize)
+    : shaderPipeline(nullptr), indexedPipeline(nullptr), textureCount(0), multiTexture(false), compactBuffers(true), indexedBuffers(false),
+      instancedPipeline(nullptr), quadVertexBuffer(nullptr), quadIndexBuffer(nullptr), instanceBuffer(nullptr), instances(nullptr),
+      instanceBufferSize(4096), instanceIndex(0), instanceTexture(nullptr), bufferSize(clampBufferSize(bufferSize)), vertexSize(4), bufferStart(0),
+      bufferIndex(0), runLength(0), peakRunLength(0), lastTexture(nullptr), lastRenderTarget(nullptr), atlas(nullptr), lastImage(nullptr),
+      bilinear(false), bilinearMipmaps(false), myPipeline(nullptr) {
 	initShaders();
 	initBuffers();
 }
@@ -36,6 +242,7 @@ void Graphics2::ImageShaderPainter::set_pipeline(Graphics4::PipelineState* pipe)
 		textureLocation = pipe->getTextureUnit("tex");
 		myPipeline = pipe;
 	}
+	updateLayout();
 }
 
 void Graphics2::ImageShaderPainter::setProjection(mat4 projectionMatrix) {
@@ -48,9 +255,10 @@ void Graphics2::ImageShaderPainter::initShaders() {
 	structure.add("vertexPosition", Graphics4::Float3VertexData);
 	structure.add("texPosition", Graphics4::Float2VertexData);
 	structure.add("vertexColor", Graphics4::Float4VertexData);
+	addCompactStructure(compactStructure, true);
 
 	FileReader fs("painter-image.frag");
-	FileReader vs("painter-image.vert");
+	FileReader vs("painter-image-compact.vert");
 	Graphics4::Shader* fragmentShader = new Graphics4::Shader(fs.readAll(), fs.size(), Graphics4::FragmentShader);
 	Graphics4::Shader* vertexShader = new Graphics4::Shader(vs.readAll(), vs.size(), Graphics4::VertexShader);
 
@@ -65,7 +273,7 @@ void Graphics2::ImageShaderPainter::initShaders() {
 
 	//    shaderPipeline->inputLayout[0] = { &structure };
 	//    shaderPipeline->compile();
-	shaderPipeline->inputLayout[0] = &structure;
+	shaderPipeline->inputLayout[0] = &compactStructure;
 	shaderPipeline->inputLayout[1] = nullptr;
 	shaderPipeline->compile();
 
@@ -75,107 +283,219 @@ void Graphics2::ImageShaderPainter::initShaders() {
 	myPipeline = shaderPipeline;
 }
 
-void Graphics2::ImageShaderPainter::initBuffers() {
-	rectVertexBuffer = new Graphics4::VertexBuffer(bufferSize * 4, structure);
-	rectVertices = rectVertexBuffer->lock();
-
-	indexBuffer = new Graphics4::IndexBuffer(bufferSize * 3 * 2);
-	int* indices = indexBuffer->lock();
-	for (int i = 0; i < bufferSize; ++i) {
-		indices[i * 3 * 2 + 0] = i * 4 + 0;
-		indices[i * 3 * 2 + 1] = i * 4 + 1;
-		indices[i * 3 * 2 + 2] = i * 4 + 2;
-		indices[i * 3 * 2 + 3] = i * 4 + 0;
-		indices[i * 3 * 2 + 4] = i * 4 + 2;
-		indices[i * 3 * 2 + 5] = i * 4 + 3;
+void Graphics2::ImageShaderPainter::initIndexedShaders() {
+	if (indexedPipeline != nullptr) return;
+
+	addCompactStructure(indexedStructure, true);
+	indexedStructure.add("texIndex", Graphics4::Float1VertexData);
+
+	FileReader fs("painter-image-indexed.frag");
+	FileReader vs("painter-image-indexed.vert");
+	Graphics4::Shader* fragmentShader = new Graphics4::Shader(fs.readAll(), fs.size(), Graphics4::FragmentShader);
+	Graphics4::Shader* vertexShader = new Graphics4::Shader(vs.readAll(), vs.size(), Graphics4::VertexShader);
+
+	indexedPipeline = new Graphics4::PipelineState;
+	indexedPipeline->fragmentShader = fragmentShader;
+	indexedPipeline->vertexShader = vertexShader;
+
+	indexedPipeline->blendSource = Graphics4::BlendOne;
+	indexedPipeline->blendDestination = Graphics4::InverseSourceAlpha;
+	indexedPipeline->alphaBlendSource = Graphics4::SourceAlpha;
+	indexedPipeline->alphaBlendDestination = Graphics4::InverseSourceAlpha;
+
+	indexedPipeline->inputLayout[0] = &indexedStructure;
+	indexedPipeline->inputLayout[1] = nullptr;
+	indexedPipeline->compile();
+
+	indexedProjectionLocation = indexedPipeline->getConstantLocation("projectionMatrix");
+	char name[] = "tex0";
+	for (int i = 0; i < maxTextureSlots; ++i) {
+		name[3] = '0' + i;
+		textureLocations[i] = indexedPipeline->getTextureUnit(name);
 	}
-	indexBuffer->unlock();
 }
 
-void Graphics2::ImageShaderPainter::setRectVertices(float bottomleftx, float bottomlefty, float topleftx, float toplefty, float toprightx, float toprighty,
-                                         float bottomrightx, float bottomrighty) {
-	int baseIndex = bufferIndex * vertexSize * 4;
-	rectVertices[baseIndex + 0] = bottomleftx;
-	rectVertices[baseIndex + 1] = bottomlefty;
-	rectVertices[baseIndex + 2] = -5.f; // TODO: should be 0?
+void Graphics2::ImageShaderPainter::initInstancedShaders() {
+	if (instancedPipeline != nullptr) return;
+
+	quadStructure.add("vertexPosition", Graphics4::Float2VertexData);
+	// The transformation maps the unit quad to the destination, its columns plus the translation
+	instanceStructure.add("spriteX", Graphics4::Float2VertexData);
+	instanceStructure.add("spriteY", Graphics4::Float2VertexData);
+	instanceStructure.add("spriteOrigin", Graphics4::Float2VertexData);
+	instanceStructure.add("spriteSource", Graphics4::Short4NormVertexData);
+	instanceStructure.add("spriteColor", Graphics4::Byte4NormVertexData);
+	instanceStructure.instanced = true;
+
+	FileReader fs("painter-image.frag");
+	FileReader vs("painter-image-instanced.vert");
+	Graphics4::Shader* fragmentShader = new Graphics4::Shader(fs.readAll(), fs.size(), Graphics4::FragmentShader);
+	Graphics4::Shader* vertexShader = new Graphics4::Shader(vs.readAll(), vs.size(), Graphics4::VertexShader);
+
+	instancedPipeline = new Graphics4::PipelineState;
+	instancedPipeline->fragmentShader = fragmentShader;
+	instancedPipeline->vertexShader = vertexShader;
+
+	instancedPipeline->blendSource = Graphics4::BlendOne;
+	instancedPipeline->blendDestination = Graphics4::InverseSourceAlpha;
+	instancedPipeline->alphaBlendSource = Graphics4::SourceAlpha;
+	instancedPipeline->alphaBlendDestination = Graphics4::InverseSourceAlpha;
+
+	instancedPipeline->inputLayout[0] = &quadStructure;
+	instancedPipeline->inputLayout[1] = &instanceStructure;
+	instancedPipeline->inputLayout[2] = nullptr;
+	instancedPipeline->compile();
 
-	rectVertices[baseIndex + 9] = topleftx;
-	rectVertices[baseIndex + 10] = toplefty;
-	rectVertices[baseIndex + 11] = -5.f;
+	instancedProjectionLocation = instancedPipeline->getConstantLocation("projectionMatrix");
+	instancedTextureLocation = instancedPipeline->getTextureUnit("tex");
 
-	rectVertices[baseIndex + 18] = toprightx;
-	rectVertices[baseIndex + 19] = toprighty;
-	rectVertices[baseIndex + 20] = -5.f;
+	// bottom-left, top-left, top-right, bottom-right like the regular quads
+	quadVertexBuffer = new Graphics4::VertexBuffer(4, quadStructure);
+	float* corners = quadVertexBuffer->lock();
+	corners[0] = 0.0f;
+	corners[1] = 1.0f;
+	corners[2] = 0.0f;
+	corners[3] = 0.0f;
+	corners[4] = 1.0f;
+	corners[5] = 0.0f;
+	corners[6] = 1.0f;
+	corners[7] = 1.0f;
+	quadVertexBuffer->unlock();
 
-	rectVertices[baseIndex + 27] = bottomrightx;
-	rectVertices[baseIndex + 28] = bottomrighty;
-	rectVertices[baseIndex + 29] = -5.f;
+	quadIndexBuffer = new Graphics4::IndexBuffer(6);
+	initQuadIndices(quadIndexBuffer, 1);
+
+	// The instance data can not be offset without base instance support, so every batch discards the buffer
+	instanceBuffer = new Graphics4::VertexBuffer(instanceBufferSize, instanceStructure, Graphics4::DynamicUsage, 1);
+	instances = instanceBuffer->lock(0, instanceBufferSize);
 }
 
-void Graphics2::ImageShaderPainter::setRectTexCoords(float left, float top, float right, float bottom) {
-	int baseIndex = bufferIndex * vertexSize * 4;
-	rectVertices[baseIndex + 3] = left;
-	rectVertices[baseIndex + 4] = bottom;
+void Graphics2::ImageShaderPainter::initBuffers() {
+	rectVertexBuffer = new Graphics4::VertexBuffer(bufferSize * 4 * streamBatches, indexedBuffers ? indexedStructure : compactBuffers ? compactStructure : structure,
+	                                               Graphics4::DynamicUsage);
+	rectVertices = lockBatch(rectVertexBuffer, 0, bufferSize * 4);
+	streams[indexedBuffers ? 2 : compactBuffers ? 1 : 0].buffer = rectVertexBuffer;
 
-	rectVertices[baseIndex + 12] = left;
-	rectVertices[baseIndex + 13] = top;
+	indexBuffer = new Graphics4::IndexBuffer(bufferSize * 3 * 2 * streamBatches);
+	initQuadIndices(indexBuffer, bufferSize * streamBatches);
+}
 
-	rectVertices[baseIndex + 21] = right;
-	rectVertices[baseIndex + 22] = top;
+void Graphics2::ImageShaderPainter::setRectVertices(float bottomleftx, float bottomlefty, float topleftx, float toplefty, float toprightx, float toprighty,
+                                         float bottomrightx, float bottomrighty) {
+	float positions[] = {bottomleftx, bottomlefty, topleftx, toplefty, toprightx, toprighty, bottomrightx, bottomrighty};
+	setPositions(&rectVertices[bufferIndex * vertexSize * 4], vertexSize, compactBuffers, positions, 4);
+}
 
-	rectVertices[baseIndex + 30] = right;
-	rectVertices[baseIndex + 31] = bottom;
+void Graphics2::ImageShaderPainter::setRectTexCoords(float left, float top, float right, float bottom) {
+	setTexCoords(&rectVertices[bufferIndex * vertexSize * 4], vertexSize, compactBuffers, left, top, right, bottom);
 }
 
-void Graphics2::ImageShaderPainter::setRectColor(float r, float g, float b, float a) {
-	int baseIndex = bufferIndex * vertexSize * 4;
-	rectVertices[baseIndex + 5] = r;
-	rectVertices[baseIndex + 6] = g;
-	rectVertices[baseIndex + 7] = b;
-	rectVertices[baseIndex + 8] = a;
+void Graphics2::ImageShaderPainter::setRectColor(uint color, float alpha) {
+	setColors(&rectVertices[bufferIndex * vertexSize * 4], vertexSize, compactBuffers, compactBuffers ? 3 : 5, color, alpha, 4);
+}
 
-	rectVertices[baseIndex + 14] = r;
-	rectVertices[baseIndex + 15] = g;
-	rectVertices[baseIndex + 16] = b;
-	rectVertices[baseIndex + 17] = a;
+void Graphics2::ImageShaderPainter::setRectTexIndex(float index) {
+	float* vertices = &rectVertices[bufferIndex * vertexSize * 4];
+	vertices[4] = index;
+	vertices[vertexSize + 4] = index;
+	vertices[vertexSize * 2 + 4] = index;
+	vertices[vertexSize * 3 + 4] = index;
+}
 
-	rectVertices[baseIndex + 23] = r;
-	rectVertices[baseIndex + 24] = g;
-	rectVertices[baseIndex + 25] = b;
-	rectVertices[baseIndex + 26] = a;
+void Graphics2::ImageShaderPainter::setTextureParameters(Graphics4::TextureUnit unit) {
+	Graphics4::setTextureAddressing(unit, Graphics4::U, Graphics4::Clamp);
+	Graphics4::setTextureAddressing(unit, Graphics4::V, Graphics4::Clamp);
+	Graphics4::setTextureMinificationFilter(unit, bilinear ? Graphics4::LinearFilter : Graphics4::PointFilter);
+	Graphics4::setTextureMagnificationFilter(unit, bilinear ? Graphics4::LinearFilter : Graphics4::PointFilter);
+	Graphics4::setTextureMipmapFilter(unit, Graphics4::NoMipFilter);
+}
 
-	rectVertices[baseIndex + 32] = r;
-	rectVertices[baseIndex + 33] = g;
-	rectVertices[baseIndex + 34] = b;
-	rectVertices[baseIndex + 35] = a;
+void Graphics2::ImageShaderPainter::setTexture(Graphics4::TextureUnit unit, Graphics4::Texture* texture) {
+	if (atlas != nullptr && texture == atlas->getTexture()) atlas->update();
+	Graphics4::setTexture(unit, texture);
+	setTextureParameters(unit);
 }
 
-void Graphics2::ImageShaderPainter::drawBuffer() {
-	rectVertexBuffer->unlock();
-	Graphics4::setPipeline(myPipeline);
+void Graphics2::ImageShaderPainter::drawBuffer(bool full) {
+	countFlush(stats, runLength, peakRunLength, bufferIndex, full);
+	rectVertexBuffer->unlock(bufferIndex * 4);
+	Graphics4::setPipeline(indexedBuffers ? indexedPipeline : myPipeline);
 	Graphics4::setVertexBuffer(*rectVertexBuffer);
 	Graphics4::setIndexBuffer(*indexBuffer);
-	if (lastRenderTarget != nullptr) lastRenderTarget->useColorAsTexture(textureLocation);
-	else Graphics4::setTexture(textureLocation, lastTexture);
-	Graphics4::setTextureAddressing(textureLocation, Graphics4::U, Graphics4::Clamp);
-	Graphics4::setTextureAddressing(textureLocation, Graphics4::V, Graphics4::Clamp);
-	Graphics4::setTextureMinificationFilter(textureLocation, bilinear ? Graphics4::LinearFilter : Graphics4::PointFilter);
-	Graphics4::setTextureMagnificationFilter(textureLocation, bilinear ? Graphics4::LinearFilter : Graphics4::PointFilter);
-	Graphics4::setTextureMipmapFilter(textureLocation, Graphics4::NoMipFilter);
+	if (lastRenderTarget != nullptr) {
+		Graphics4::TextureUnit unit = indexedBuffers ? textureLocations[0] : textureLocation;
+		lastRenderTarget->useColorAsTexture(unit);
+		setTextureParameters(unit);
+	}
+	else if (indexedBuffers) {
+		for (int i = 0; i < textureCount; ++i) setTexture(textureLocations[i], textures[i]);
+	}
+	else {
+		setTexture(textureLocation, lastTexture);
+	}
 
     #ifndef KORE_G4
     // Set fixed-function projection matrix
     Graphics3::setProjectionMatrix(projectionMatrix);
     #else
     // Set shader matrix uniform
-	Graphics4::setMatrix(projectionLocation, projectionMatrix);
+	Graphics4::setMatrix(indexedBuffers ? indexedProjectionLocation : projectionLocation, projectionMatrix);
     #endif
 
-	Graphics4::drawIndexedVertices(0, bufferIndex * 2 * 3);
+	Graphics4::drawIndexedVertices(bufferStart * 2 * 3, bufferIndex * 2 * 3);
 
 	// Graphics::setTexture(textureLocation, nullptr);
+	bufferStart = nextBatchStart(bufferStart, bufferIndex, bufferSize);
 	bufferIndex = 0;
-	rectVertices = rectVertexBuffer->lock();
+	textureCount = 0;
+	rectVertices = lockBatch(rectVertexBuffer, bufferStart * 4, bufferSize * 4);
+}
+
+void Graphics2::ImageShaderPainter::drawInstances() {
+	instanceBuffer->unlock(instanceIndex);
+	Graphics4::setPipeline(instancedPipeline);
+	Graphics4::VertexBuffer* buffers[] = {quadVertexBuffer, instanceBuffer};
+	Graphics4::setVertexBuffers(buffers, 2);
+	Graphics4::setIndexBuffer(*quadIndexBuffer);
+	setTexture(instancedTextureLocation, instanceTexture);
+	Graphics4::setMatrix(instancedProjectionLocation, projectionMatrix);
+
+	Graphics4::drawIndexedVerticesInstanced(instanceIndex);
+
+	instanceIndex = 0;
+	instances = instanceBuffer->lock(0, instanceBufferSize);
+}
+
+inline void Graphics2::ImageShaderPainter::endInstances() {
+	if (instanceIndex > 0) drawInstances();
+}
+
+void Graphics2::ImageShaderPainter::setBufferSize(int size) {
+	size = clampBufferSize(size);
+	if (size == bufferSize) return;
+	end();
+	deleteStreams(streams, 3);
+	delete indexBuffer;
+	bufferSize = size;
+	bufferStart = 0;
+	initBuffers();
+}
+
+void Graphics2::ImageShaderPainter::adaptBufferSize() {
+	setBufferSize(grownBufferSize(bufferSize, peakRunLength));
+	peakRunLength = 0;
+}
+
+int Graphics2::ImageShaderPainter::getBufferSize() const {
+	return bufferSize;
+}
+
+const Graphics2::BatchStats& Graphics2::ImageShaderPainter::getStats() const {
+	return stats;
+}
+
+void Graphics2::ImageShaderPainter::resetStats() {
+	stats = BatchStats();
 }
 
 void Graphics2::ImageShaderPainter::setBilinearFilter(bool bilinear) {
@@ -188,116 +508,266 @@ void Graphics2::ImageShaderPainter::setBilinearMipmapFilter(bool bilinear) {
 	this->bilinearMipmaps = bilinear;
 }
 
+void Graphics2::ImageShaderPainter::setMultiTextureBatching(bool enabled) {
+	end();
+	if (enabled) initIndexedShaders();
+	multiTexture = enabled;
+	updateLayout();
+}
+
+// Custom pipelines expect the regular vertex layout, so texture indices are only written for the default pipeline.
+// Every layout keeps its vertex buffer, switching pipelines back and forth only swaps them.
+void Graphics2::ImageShaderPainter::updateLayout() {
+	bool compact = myPipeline == shaderPipeline;
+	bool indexed = multiTexture && compact;
+	if (compact == compactBuffers && indexed == indexedBuffers) return;
+	int from = indexedBuffers ? 2 : compactBuffers ? 1 : 0;
+	compactBuffers = compact;
+	indexedBuffers = indexed;
+	vertexSize = indexed ? 5 : compact ? 4 : 9;
+	bufferIndex = 0;
+	switchStream(streams, from, indexed ? 2 : compact ? 1 : 0, rectVertexBuffer, rectVertices, bufferStart,
+	             indexed ? indexedStructure : compact ? compactStructure : structure, bufferSize * 4);
+}
+
+bool Graphics2::ImageShaderPainter::breaksBatch(Graphics4::Texture* tex) {
+	if (lastRenderTarget != nullptr) return true;
+	if (lastTexture == nullptr || tex == lastTexture) return false;
+	if (!indexedBuffers) return true;
+	return findTextureSlot(tex) < 0 && textureCount >= maxTextureSlots;
+}
+
+int Graphics2::ImageShaderPainter::findTextureSlot(Graphics4::Texture* tex) {
+	for (int i = 0; i < textureCount; ++i) {
+		if (textures[i] == tex) return i;
+	}
+	return -1;
+}
+
+void Graphics2::ImageShaderPainter::useTextureSlot(Graphics4::Texture* tex) {
+	if (!indexedBuffers) return;
+	int slot = findTextureSlot(tex);
+	if (slot < 0) {
+		slot = textureCount++;
+		textures[slot] = tex;
+	}
+	setRectTexIndex(static_cast<float>(slot));
+}
+
+void Graphics2::ImageShaderPainter::setAtlas(TextureAtlas* atlas) {
+	end();
+	this->atlas = atlas;
+}
+
+Graphics4::Texture* Graphics2::ImageShaderPainter::useAtlas(Graphics4::Texture* img, float& sx, float& sy) {
+	int x, y;
+	if (atlas == nullptr || !atlas->lookup(img, x, y)) return img;
+	sx += x;
+	sy += y;
+	Graphics4::Texture* tex = atlas->getTexture();
+	if (lastTexture == tex && lastImage != img) atlas->_countSavedBatch();
+	return tex;
+}
+
 inline void Graphics2::ImageShaderPainter::drawImage(Graphics4::Texture* img, float bottomleftx, float bottomlefty, float topleftx, float toplefty, float toprightx,
                                           float toprighty, float bottomrightx, float bottomrighty, float opacity, uint color) {
-	Graphics4::Texture* tex = img;
-	if (bufferIndex + 1 >= bufferSize || (lastTexture != nullptr && tex != lastTexture) || lastRenderTarget != nullptr) drawBuffer();
+	drawImage2(img, 0, 0, static_cast<float>(img->width), static_cast<float>(img->height), bottomleftx, bottomlefty, topleftx, toplefty, toprightx, toprighty,
+	           bottomrightx, bottomrighty, opacity, color);
+}
 
-	Color c = Color(color);
-	setRectColor(c.R, c.G, c.B, c.A * opacity);
-	setRectTexCoords(0, 0, tex->width / (float)tex->texWidth, tex->height / (float)tex->texHeight);
+inline void Graphics2::ImageShaderPainter::drawImage2(Graphics4::Texture* img, float sx, float sy, float sw, float sh, float bottomleftx, float bottomlefty, float topleftx,
+                                           float toplefty, float toprightx, float toprighty, float bottomrightx, float bottomrighty, float opacity,
+                                           uint color) {
+	endInstances();
+	Graphics4::Texture* tex = useAtlas(img, sx, sy);
+	if (bufferIndex + 1 >= bufferSize) drawBuffer(true);
+	else if (breaksBatch(tex)) drawBuffer();
+
+	useTextureSlot(tex);
+	setRectColor(color, Color(color).A * opacity);
+	setRectTexCoords(sx / (float)tex->texWidth, sy / (float)tex->texHeight, (sx + sw) / (float)tex->texWidth, (sy + sh) / (float)tex->texHeight);
 	setRectVertices(bottomleftx, bottomlefty, topleftx, toplefty, toprightx, toprighty, bottomrightx, bottomrighty);
 
 	++bufferIndex;
 	lastTexture = tex;
+	lastImage = img;
 	lastRenderTarget = nullptr;
 }
 
-inline void Graphics2::ImageShaderPainter::drawImage2(Graphics4::Texture* img, float sx, float sy, float sw, float sh, float bottomleftx, float bottomlefty, float topleftx,
-                                           float toplefty, float toprightx, float toprighty, float bottomrightx, float bottomrighty, float opacity,
-                                           uint color) {
-	Graphics4::Texture* tex = img;
-	if (bufferIndex + 1 >= bufferSize || (lastTexture != nullptr && tex != lastTexture) || lastRenderTarget != nullptr) drawBuffer();
+inline void Graphics2::ImageShaderPainter::drawImageTransformed(Graphics4::Texture* img, float sx, float sy, float sw, float sh, float dx, float dy, float dw,
+                                                     float dh, const mat3& transformation, float opacity, uint color) {
+	endInstances();
+	Graphics4::Texture* tex = useAtlas(img, sx, sy);
+	if (bufferIndex + 1 >= bufferSize) drawBuffer(true);
+	else if (breaksBatch(tex)) drawBuffer();
 
-	Color c = Color(color);
-	setRectColor(c.R, c.G, c.B, c.A * opacity);
-	setRectTexCoords(sx / (float)tex->texWidth, sy / (float)tex->texHeight, (sx + sw) / (float)tex->texWidth, (sy + sh) / (float)tex->texHeight);
-	setRectVertices(bottomleftx, bottomlefty, topleftx, toplefty, toprightx, toprighty, bottomrightx, bottomrighty);
+	useTextureSlot(tex);
+	setRectColor(color, Color(color).A * opacity);
+	float texCoords[4];
+	float invWidth = 1.0f / tex->texWidth;
+	float invHeight = 1.0f / tex->texHeight;
+	store(texCoords, mul(load(sx, sy, sx + sw, sy + sh), load(invWidth, invHeight, invWidth, invHeight)));
+	float* vertices = &rectVertices[bufferIndex * vertexSize * 4];
+	setTexCoords(vertices, vertexSize, compactBuffers, texCoords[0], texCoords[1], texCoords[2], texCoords[3]);
+	setTransformedPositions(vertices, vertexSize, compactBuffers, transformation, dx, dy, dw, dh);
 
 	++bufferIndex;
 	lastTexture = tex;
+	lastImage = img;
 	lastRenderTarget = nullptr;
 }
 
 inline void Graphics2::ImageShaderPainter::drawImageScale(Graphics4::Texture* img, float sx, float sy, float sw, float sh, float left, float top, float right, float bottom,
 	float opacity, uint color) {
-	Graphics4::Texture* tex = img;
-	if (bufferIndex + 1 >= bufferSize || (lastTexture != nullptr && tex != lastTexture) || lastRenderTarget != nullptr) drawBuffer();
+	endInstances();
+	Graphics4::Texture* tex = useAtlas(img, sx, sy);
+	if (bufferIndex + 1 >= bufferSize) drawBuffer(true);
+	else if (breaksBatch(tex)) drawBuffer();
 
-	Color c = Color(color);
-	setRectColor(c.R, c.G, c.B, opacity);
+	useTextureSlot(tex);
+	setRectColor(color, opacity);
 	setRectTexCoords(sx / (float)tex->texWidth, sy / (float)tex->texHeight, (sx + sw) / (float)tex->texWidth, (sy + sh) / (float)tex->texHeight);
 	setRectVertices(left, bottom, left, top, right, top, right, bottom);
 
 	++bufferIndex;
 	lastTexture = tex;
+	lastImage = img;
 	lastRenderTarget = nullptr;
 }
 
 inline void Graphics2::ImageShaderPainter::drawImage(Graphics4::RenderTarget* img, float bottomleftx, float bottomlefty, float topleftx, float toplefty, float toprightx,
 	float toprighty, float bottomrightx, float bottomrighty, float opacity, uint color) {
+	endInstances();
 	Graphics4::RenderTarget* tex = img;
-	if (bufferIndex + 1 >= bufferSize || (lastRenderTarget != nullptr && tex != lastRenderTarget) || lastTexture != nullptr) drawBuffer();
+	if (bufferIndex + 1 >= bufferSize) drawBuffer(true);
+	else if ((lastRenderTarget != nullptr && tex != lastRenderTarget) || lastTexture != nullptr) drawBuffer();
 
-	Color c = Color(color);
-	setRectColor(c.R, c.G, c.B, c.A * opacity);
+	if (indexedBuffers) setRectTexIndex(0);
+	setRectColor(color, Color(color).A * opacity);
 	setRectTexCoords(0, 0, tex->width / (float)tex->texWidth, tex->height / (float)tex->texHeight);
 	setRectVertices(bottomleftx, bottomlefty, topleftx, toplefty, toprightx, toprighty, bottomrightx, bottomrighty);
 
 	++bufferIndex;
 	lastRenderTarget = tex;
 	lastTexture = nullptr;
+	lastImage = nullptr;
 }
 
 inline void Graphics2::ImageShaderPainter::drawImage2(Graphics4::RenderTarget* img, float sx, float sy, float sw, float sh, float bottomleftx, float bottomlefty, float topleftx,
 	float toplefty, float toprightx, float toprighty, float bottomrightx, float bottomrighty, float opacity,
 	uint color) {
+	endInstances();
 	Graphics4::RenderTarget* tex = img;
-	if (bufferIndex + 1 >= bufferSize || (lastRenderTarget != nullptr && tex != lastRenderTarget) || lastTexture != nullptr) drawBuffer();
+	if (bufferIndex + 1 >= bufferSize) drawBuffer(true);
+	else if ((lastRenderTarget != nullptr && tex != lastRenderTarget) || lastTexture != nullptr) drawBuffer();
 
-	Color c = Color(color);
-	setRectColor(c.R, c.G, c.B, c.A * opacity);
+	if (indexedBuffers) setRectTexIndex(0);
+	setRectColor(color, Color(color).A * opacity);
 	setRectTexCoords(sx / (float)tex->texWidth, sy / (float)tex->texHeight, (sx + sw) / (float)tex->texWidth, (sy + sh) / (float)tex->texHeight);
 	setRectVertices(bottomleftx, bottomlefty, topleftx, toplefty, toprightx, toprighty, bottomrightx, bottomrighty);
 
 	++bufferIndex;
 	lastRenderTarget = tex;
 	lastTexture = nullptr;
+	lastImage = nullptr;
 }
 
 inline void Graphics2::ImageShaderPainter::drawImageScale(Graphics4::RenderTarget* img, float sx, float sy, float sw, float sh, float left, float top, float right, float bottom,
                                                float opacity, uint color) {
+	endInstances();
 	Graphics4::RenderTarget* tex = img;
-	if (bufferIndex + 1 >= bufferSize || (lastRenderTarget != nullptr && tex != lastRenderTarget) || lastTexture != nullptr) drawBuffer();
+	if (bufferIndex + 1 >= bufferSize) drawBuffer(true);
+	else if ((lastRenderTarget != nullptr && tex != lastRenderTarget) || lastTexture != nullptr) drawBuffer();
 
-	Color c = Color(color);
-	setRectColor(c.R, c.G, c.B, opacity);
+	if (indexedBuffers) setRectTexIndex(0);
+	setRectColor(color, opacity);
 	setRectTexCoords(sx / (float)tex->texWidth, sy / (float)tex->texHeight, (sx + sw) / (float)tex->texWidth, (sy + sh) / (float)tex->texHeight);
 	setRectVertices(left, bottom, left, top, right, top, right, bottom);
 
 	++bufferIndex;
 	lastRenderTarget = tex;
 	lastTexture = nullptr;
+	lastImage = nullptr;
+}
+
+// Custom pipelines and backends without instancing receive regular quads
+void Graphics2::ImageShaderPainter::drawSprites(Graphics4::Texture* img, const Sprite* sprites, int count, const mat3& transformation, float opacity) {
+#ifndef KORE_OPENGL_ES
+	if (myPipeline == shaderPipeline) {
+		initInstancedShaders();
+		if (bufferIndex > 0) drawBuffer();
+		lastTexture = nullptr;
+		lastImage = nullptr;
+		lastRenderTarget = nullptr;
+
+		float offsetx = 0, offsety = 0;
+		Graphics4::Texture* tex = useAtlas(img, offsetx, offsety);
+		if (instanceIndex > 0 && tex != instanceTexture) drawInstances();
+		instanceTexture = tex;
+
+		float a = transformation.get(0, 0), c = transformation.get(0, 1), e = transformation.get(0, 2);
+		float b = transformation.get(1, 0), d = transformation.get(1, 1), f = transformation.get(1, 2);
+		float texWidth = (float)tex->texWidth;
+		float texHeight = (float)tex->texHeight;
+
+		for (int i = 0; i < count; ++i) {
+			if (instanceIndex >= instanceBufferSize) drawInstances();
+			const Sprite& sprite = sprites[i];
+			float* instance = &instances[instanceIndex * 9];
+			instance[0] = a * sprite.dw;
+			instance[1] = b * sprite.dw;
+			instance[2] = c * sprite.dh;
+			instance[3] = d * sprite.dh;
+			instance[4] = a * sprite.dx + c * sprite.dy + e;
+			instance[5] = b * sprite.dx + d * sprite.dy + f;
+			u32* words = (u32*)instance;
+			float sx = offsetx + sprite.sx;
+			float sy = offsety + sprite.sy;
+			words[6] = packTexCoords(sx / texWidth, sy / texHeight);
+			words[7] = packTexCoords((sx + sprite.sw) / texWidth, (sy + sprite.sh) / texHeight);
+			words[8] = packColor(sprite.color, ((sprite.color >> 24) & 0xff) / 255.0f * opacity);
+			++instanceIndex;
+		}
+		return;
+	}
+#endif
+	for (int i = 0; i < count; ++i) {
+		const Sprite& sprite = sprites[i];
+		vec2 p1 = transformation * vec3(sprite.dx, sprite.dy + sprite.dh, 1.0f);
+		vec2 p2 = transformation * vec3(sprite.dx, sprite.dy, 1.0f);
+		vec2 p3 = transformation * vec3(sprite.dx + sprite.dw, sprite.dy, 1.0f);
+		vec2 p4 = transformation * vec3(sprite.dx + sprite.dw, sprite.dy + sprite.dh, 1.0f);
+		drawImage2(img, sprite.sx, sprite.sy, sprite.sw, sprite.sh, p1.x(), p1.y(), p2.x(), p2.y(), p3.x(), p3.y(), p4.x(), p4.y(), opacity, sprite.color);
+	}
 }
 
 void Graphics2::ImageShaderPainter::end() {
+	endInstances();
 	if (bufferIndex > 0) drawBuffer();
 	lastTexture = nullptr;
+	lastImage = nullptr;
 	lastRenderTarget = nullptr;
 }
 
 Graphics2::ImageShaderPainter::~ImageShaderPainter() {
 	delete shaderPipeline;
-	delete rectVertexBuffer;
+	delete indexedPipeline;
+	delete instancedPipeline;
+	deleteStreams(streams, 3);
 	delete indexBuffer;
+	delete quadVertexBuffer;
+	delete quadIndexBuffer;
+	delete instanceBuffer;
 }
 
 //==========
 // ColoredShaderPainter
 //==========
 
-Graphics2::ColoredShaderPainter::ColoredShaderPainter()
-    : bufferSize(100), bufferIndex(0), vertexSize(7), triangleBufferSize(100), triangleBufferIndex(0), shaderPipeline(nullptr) {
+Graphics2::ColoredShaderPainter::ColoredShaderPainter(int bufferSize, int triangleBufferSize)
+    : shaderPipeline(nullptr), compactBuffers(true), bufferSize(clampBufferSize(bufferSize)), vertexSize(3), bufferStart(0), bufferIndex(0),
+      triangleBufferSize(clampBufferSize(triangleBufferSize)), triangleBufferStart(0), triangleBufferIndex(0), runLength(0), peakRunLength(0),
+      triangleRunLength(0), triangleRunPeak(0) {
 	initShaders();
 	initBuffers();
 }
@@ -315,6 +785,7 @@ void Graphics2::ColoredShaderPainter::set_pipeline(Graphics4::PipelineState* pip
 		projectionLocation = pipe->getConstantLocation("projectionMatrix");
 		myPipeline = pipe;
 	}
+	updateLayout();
 }
 
 void Graphics2::ColoredShaderPainter::setProjection(mat4 projectionMatrix) {
@@ -326,9 +797,10 @@ void Graphics2::ColoredShaderPainter::initShaders() {
 
 	structure.add("vertexPosition", Graphics4::Float3VertexData);
 	structure.add("vertexColor", Graphics4::Float4VertexData);
+	addCompactStructure(compactStructure, false);
 
 	FileReader fs("painter-colored.frag");
-	FileReader vs("painter-colored.vert");
+	FileReader vs("painter-colored-compact.vert");
 	Graphics4::Shader* fragmentShader = new Graphics4::Shader(fs.readAll(), fs.size(), Graphics4::FragmentShader);
 	Graphics4::Shader* vertexShader = new Graphics4::Shader(vs.readAll(), vs.size(), Graphics4::VertexShader);
 
@@ -343,7 +815,7 @@ void Graphics2::ColoredShaderPainter::initShaders() {
 
 	//  shaderPipeline->inputLayout[0] = { &structure };
 	//  shaderPipeline->compile();
-	shaderPipeline->inputLayout[0] = &structure;
+	shaderPipeline->inputLayout[0] = &compactStructure;
 	shaderPipeline->inputLayout[1] = nullptr;
 	shaderPipeline->compile();
 
@@ -352,27 +824,22 @@ void Graphics2::ColoredShaderPainter::initShaders() {
 }
 
 void Graphics2::ColoredShaderPainter::initBuffers() {
-	rectVertexBuffer = new Graphics4::VertexBuffer(bufferSize * 4, structure);
-	rectVertices = rectVertexBuffer->lock();
-
-	indexBuffer = new Graphics4::IndexBuffer(bufferSize * 3 * 2);
-	int* indices = indexBuffer->lock();
-	for (int i = 0; i < bufferSize; ++i) {
-		indices[i * 3 * 2 + 0] = i * 4 + 0;
-		indices[i * 3 * 2 + 1] = i * 4 + 1;
-		indices[i * 3 * 2 + 2] = i * 4 + 2;
-		indices[i * 3 * 2 + 3] = i * 4 + 0;
-		indices[i * 3 * 2 + 4] = i * 4 + 2;
-		indices[i * 3 * 2 + 5] = i * 4 + 3;
-	}
-	indexBuffer->unlock();
+	Graphics4::VertexStructure& layout = compactBuffers ? compactStructure : structure;
+
+	rectVertexBuffer = new Graphics4::VertexBuffer(bufferSize * 4 * streamBatches, layout, Graphics4::DynamicUsage);
+	rectVertices = lockBatch(rectVertexBuffer, 0, bufferSize * 4);
+	rectStreams[compactBuffers ? 1 : 0].buffer = rectVertexBuffer;
+
+	indexBuffer = new Graphics4::IndexBuffer(bufferSize * 3 * 2 * streamBatches);
+	initQuadIndices(indexBuffer, bufferSize * streamBatches);
 
-	triangleVertexBuffer = new Graphics4::VertexBuffer(triangleBufferSize * 3, structure);
-	triangleVertices = triangleVertexBuffer->lock();
+	triangleVertexBuffer = new Graphics4::VertexBuffer(triangleBufferSize * 3 * streamBatches, layout, Graphics4::DynamicUsage);
+	triangleVertices = lockBatch(triangleVertexBuffer, 0, triangleBufferSize * 3);
+	triangleStreams[compactBuffers ? 1 : 0].buffer = triangleVertexBuffer;
 
-	triangleIndexBuffer = new Graphics4::IndexBuffer(triangleBufferSize * 3);
+	triangleIndexBuffer = new Graphics4::IndexBuffer(triangleBufferSize * 3 * streamBatches);
 	int* triIndices = triangleIndexBuffer->lock();
-	for (int i = 0; i < bufferSize; ++i) {
+	for (int i = 0; i < triangleBufferSize * streamBatches; ++i) {
 		triIndices[i * 3 + 0] = i * 3 + 0;
 		triIndices[i * 3 + 1] = i * 3 + 1;
 		triIndices[i * 3 + 2] = i * 3 + 2;
@@ -380,98 +847,43 @@ void Graphics2::ColoredShaderPainter::initBuffers() {
 	triangleIndexBuffer->unlock();
 }
 
+// Custom pipelines expect the regular vertex layout, both layouts keep their vertex buffers
+void Graphics2::ColoredShaderPainter::updateLayout() {
+	bool compact = myPipeline == shaderPipeline;
+	if (compact == compactBuffers) return;
+	compactBuffers = compact;
+	vertexSize = compact ? 3 : 7;
+	bufferIndex = triangleBufferIndex = 0;
+	Graphics4::VertexStructure& layout = compact ? compactStructure : structure;
+	switchStream(rectStreams, compact ? 0 : 1, compact ? 1 : 0, rectVertexBuffer, rectVertices, bufferStart, layout, bufferSize * 4);
+	switchStream(triangleStreams, compact ? 0 : 1, compact ? 1 : 0, triangleVertexBuffer, triangleVertices, triangleBufferStart, layout,
+	             triangleBufferSize * 3);
+}
+
 void Graphics2::ColoredShaderPainter::setRectVertices(float bottomleftx, float bottomlefty, float topleftx, float toplefty, float toprightx, float toprighty,
                                            float bottomrightx, float bottomrighty) {
-	int baseIndex = bufferIndex * vertexSize * 4;
-	rectVertices[baseIndex + 0] = bottomleftx;
-	rectVertices[baseIndex + 1] = bottomlefty;
-	rectVertices[baseIndex + 2] = -5.0; // TODO: should be 0?
-
-	rectVertices[baseIndex + 7] = topleftx;
-	rectVertices[baseIndex + 8] = toplefty;
-	rectVertices[baseIndex + 9] = -5.0;
-
-	rectVertices[baseIndex + 14] = toprightx;
-	rectVertices[baseIndex + 15] = toprighty;
-	rectVertices[baseIndex + 16] = -5.0;
-
-	rectVertices[baseIndex + 21] = bottomrightx;
-	rectVertices[baseIndex + 22] = bottomrighty;
-	rectVertices[baseIndex + 23] = -5.0;
+	float positions[] = {bottomleftx, bottomlefty, topleftx, toplefty, toprightx, toprighty, bottomrightx, bottomrighty};
+	setPositions(&rectVertices[bufferIndex * vertexSize * 4], vertexSize, compactBuffers, positions, 4);
 }
 
 void Graphics2::ColoredShaderPainter::setRectColors(float opacity, uint color) {
-	Color c = Color(color);
-	float r = c.R;
-	float g = c.G;
-	float b = c.B;
-	float a = c.A * opacity;
-
-	int baseIndex = bufferIndex * vertexSize * 4;
-	rectVertices[baseIndex + 3] = r;
-	rectVertices[baseIndex + 4] = g;
-	rectVertices[baseIndex + 5] = b;
-	rectVertices[baseIndex + 6] = a;
-
-	rectVertices[baseIndex + 10] = r;
-	rectVertices[baseIndex + 11] = g;
-	rectVertices[baseIndex + 12] = b;
-	rectVertices[baseIndex + 13] = a;
-
-	rectVertices[baseIndex + 17] = r;
-	rectVertices[baseIndex + 18] = g;
-	rectVertices[baseIndex + 19] = b;
-	rectVertices[baseIndex + 20] = a;
-
-	rectVertices[baseIndex + 24] = r;
-	rectVertices[baseIndex + 25] = g;
-	rectVertices[baseIndex + 26] = b;
-	rectVertices[baseIndex + 27] = a;
+	setColors(&rectVertices[bufferIndex * vertexSize * 4], vertexSize, compactBuffers, compactBuffers ? 2 : 3, color, Color(color).A * opacity, 4);
 }
 
 void Graphics2::ColoredShaderPainter::setTriVertices(float x1, float y1, float x2, float y2, float x3, float y3) {
-	int baseIndex = triangleBufferIndex * 7 * 3;
-	triangleVertices[baseIndex + 0] = x1;
-	triangleVertices[baseIndex + 1] = y1;
-	triangleVertices[baseIndex + 2] = -5.0; // TODO: should be 0?
-
-	triangleVertices[baseIndex + 7] = x2;
-	triangleVertices[baseIndex + 8] = y2;
-	triangleVertices[baseIndex + 9] = -5.0;
-
-	triangleVertices[baseIndex + 14] = x3;
-	triangleVertices[baseIndex + 15] = y3;
-	triangleVertices[baseIndex + 16] = -5.0;
+	float positions[] = {x1, y1, x2, y2, x3, y3};
+	setPositions(&triangleVertices[triangleBufferIndex * vertexSize * 3], vertexSize, compactBuffers, positions, 3);
 }
 
 void Graphics2::ColoredShaderPainter::setTriColors(float opacity, uint color) {
-	Color c = Color(color);
-	float r = c.R;
-	float g = c.G;
-	float b = c.B;
-	float a = c.A * opacity;
-
-	int baseIndex = triangleBufferIndex * 7 * 3;
-	triangleVertices[baseIndex + 3] = r;
-	triangleVertices[baseIndex + 4] = g;
-	triangleVertices[baseIndex + 5] = b;
-	triangleVertices[baseIndex + 6] = a;
-
-	triangleVertices[baseIndex + 10] = r;
-	triangleVertices[baseIndex + 11] = g;
-	triangleVertices[baseIndex + 12] = b;
-	triangleVertices[baseIndex + 13] = a;
-
-	triangleVertices[baseIndex + 17] = r;
-	triangleVertices[baseIndex + 18] = g;
-	triangleVertices[baseIndex + 19] = b;
-	triangleVertices[baseIndex + 20] = a;
-}
-
-void Graphics2::ColoredShaderPainter::drawBuffer(bool trisDone) {
+	setColors(&triangleVertices[triangleBufferIndex * vertexSize * 3], vertexSize, compactBuffers, compactBuffers ? 2 : 3, color, Color(color).A * opacity, 3);
+}
+
+void Graphics2::ColoredShaderPainter::drawBuffer(bool trisDone, bool full) {
 	if (!trisDone) endTris(true);
 
-	rectVertexBuffer->unlock();
+	countFlush(stats, runLength, peakRunLength, bufferIndex, full);
+	rectVertexBuffer->unlock(bufferIndex * 4);
 
 	Graphics4::setPipeline(myPipeline);
 	Graphics4::setVertexBuffer(*rectVertexBuffer);
@@ -485,16 +897,18 @@ void Graphics2::ColoredShaderPainter::drawBuffer(bool trisDone) {
 	Graphics4::setMatrix(projectionLocation, projectionMatrix);
     #endif
 
-	Graphics4::drawIndexedVertices(0, bufferIndex * 2 * 3);
+	Graphics4::drawIndexedVertices(bufferStart * 2 * 3, bufferIndex * 2 * 3);
 
+	bufferStart = nextBatchStart(bufferStart, bufferIndex, bufferSize);
 	bufferIndex = 0;
-	rectVertices = rectVertexBuffer->lock();
+	rectVertices = lockBatch(rectVertexBuffer, bufferStart * 4, bufferSize * 4);
 }
 
-void Graphics2::ColoredShaderPainter::drawTriBuffer(bool rectsDone) {
+void Graphics2::ColoredShaderPainter::drawTriBuffer(bool rectsDone, bool full) {
 	if (!rectsDone) endRects(true);
 
-	triangleVertexBuffer->unlock();
+	countFlush(stats, triangleRunLength, triangleRunPeak, triangleBufferIndex, full);
+	triangleVertexBuffer->unlock(triangleBufferIndex * 3);
 
 	Graphics4::setPipeline(myPipeline);
 	Graphics4::setVertexBuffer(*triangleVertexBuffer);
@@ -508,33 +922,82 @@ void Graphics2::ColoredShaderPainter::drawTriBuffer(bool rectsDone) {
 	Graphics4::setMatrix(projectionLocation, projectionMatrix);
     #endif
 
-	Graphics4::drawIndexedVertices(0, triangleBufferIndex * 3);
+	Graphics4::drawIndexedVertices(triangleBufferStart * 3, triangleBufferIndex * 3);
 
+	triangleBufferStart = nextBatchStart(triangleBufferStart, triangleBufferIndex, triangleBufferSize);
 	triangleBufferIndex = 0;
-	triangleVertices = triangleVertexBuffer->lock();
+	triangleVertices = lockBatch(triangleVertexBuffer, triangleBufferStart * 3, triangleBufferSize * 3);
 }
 
 void Graphics2::ColoredShaderPainter::fillRect(float opacity, uint color, float bottomleftx, float bottomlefty, float topleftx, float toplefty, float toprightx,
                                     float toprighty, float bottomrightx, float bottomrighty) {
 	if (triangleBufferIndex > 0) drawTriBuffer(true); // Flush other buffer for right render order
 
-	if (bufferIndex + 1 >= bufferSize) drawBuffer(false);
+	if (bufferIndex + 1 >= bufferSize) drawBuffer(false, true);
 
 	setRectColors(opacity, color);
 	setRectVertices(bottomleftx, bottomlefty, topleftx, toplefty, toprightx, toprighty, bottomrightx, bottomrighty);
 	++bufferIndex;
 }
 
+void Graphics2::ColoredShaderPainter::fillRectTransformed(float opacity, uint color, float x, float y, float width, float height, const mat3& transformation) {
+	if (triangleBufferIndex > 0) drawTriBuffer(true); // Flush other buffer for right render order
+
+	if (bufferIndex + 1 >= bufferSize) drawBuffer(false, true);
+
+	setRectColors(opacity, color);
+	setTransformedPositions(&rectVertices[bufferIndex * vertexSize * 4], vertexSize, compactBuffers, transformation, x, y, width, height);
+	++bufferIndex;
+}
+
 void Graphics2::ColoredShaderPainter::fillTriangle(float opacity, uint color, float x1, float y1, float x2, float y2, float x3, float y3) {
 	if (bufferIndex > 0) drawBuffer(true); // Flush other buffer for right render order
 
-	if (triangleBufferIndex + 1 >= triangleBufferSize) drawTriBuffer(false);
+	if (triangleBufferIndex + 1 >= triangleBufferSize) drawTriBuffer(false, true);
 
 	setTriColors(opacity, color);
 	setTriVertices(x1, y1, x2, y2, x3, y3);
 	++triangleBufferIndex;
 }
 
+void Graphics2::ColoredShaderPainter::setBufferSizes(int size, int triangleSize) {
+	size = clampBufferSize(size);
+	triangleSize = clampBufferSize(triangleSize);
+	if (size == bufferSize && triangleSize == triangleBufferSize) return;
+	end();
+	deleteStreams(rectStreams, 2);
+	delete indexBuffer;
+	deleteStreams(triangleStreams, 2);
+	delete triangleIndexBuffer;
+	bufferSize = size;
+	triangleBufferSize = triangleSize;
+	bufferStart = 0;
+	triangleBufferStart = 0;
+	initBuffers();
+}
+
+void Graphics2::ColoredShaderPainter::adaptBufferSize() {
+	setBufferSizes(grownBufferSize(bufferSize, peakRunLength), grownBufferSize(triangleBufferSize, triangleRunPeak));
+	peakRunLength = 0;
+	triangleRunPeak = 0;
+}
+
+int Graphics2::ColoredShaderPainter::getBufferSize() const {
+	return bufferSize;
+}
+
+int Graphics2::ColoredShaderPainter::getTriangleBufferSize() const {
+	return triangleBufferSize;
+}
+
+const Graphics2::BatchStats& Graphics2::ColoredShaderPainter::getStats() const {
+	return stats;
+}
+
+void Graphics2::ColoredShaderPainter::resetStats() {
+	stats = BatchStats();
+}
+
 inline void Graphics2::ColoredShaderPainter::endTris(bool rectsDone) {
 	if (triangleBufferIndex > 0) drawTriBuffer(rectsDone);
 }
@@ -550,16 +1013,18 @@ void Graphics2::ColoredShaderPainter::end() {
 
 Graphics2::ColoredShaderPainter::~ColoredShaderPainter() {
 	delete shaderPipeline;
-	delete rectVertexBuffer;
+	deleteStreams(rectStreams, 2);
 	delete indexBuffer;
-	delete triangleVertexBuffer;
+	deleteStreams(triangleStreams, 2);
 	delete triangleIndexBuffer;
 }
 
 //==========
 // TextShaderPainter
 //==========
-Graphics2::TextShaderPainter::TextShaderPainter() : bufferSize(100), bufferIndex(0), vertexSize(9), bilinear(false), lastTexture(nullptr), shaderPipeline(nullptr) {
+Graphics2::TextShaderPainter::TextShaderPainter(int bufferSize)
+    : shaderPipeline(nullptr), compactBuffers(true), sdfPipeline(nullptr), sdfBatch(false), bufferSize(clampBufferSize(bufferSize)), bufferStart(0),
+      bufferIndex(0), vertexSize(4), runLength(0), peakRunLength(0), layoutCacheSize(256), lastTexture(nullptr), bilinear(false), fontSize(14) {
 	initShaders();
 	initBuffers();
 }
@@ -572,12 +1037,14 @@ void Graphics2::TextShaderPainter::set_pipeline(Graphics4::PipelineState* pipe)
 	if (pipe == nullptr) {
 		projectionLocation = shaderPipeline->getConstantLocation("projectionMatrix");
 		textureLocation = shaderPipeline->getTextureUnit("tex");
+		myPipeline = shaderPipeline;
 	}
 	else {
 		projectionLocation = pipe->getConstantLocation("projectionMatrix");
 		textureLocation = pipe->getTextureUnit("tex");
+		myPipeline = pipe;
 	}
-	myPipeline = pipe;
+	updateLayout();
 }
 
 void Graphics2::TextShaderPainter::setProjection(mat4 projectionMatrix) {
@@ -590,9 +1057,10 @@ void Graphics2::TextShaderPainter::initShaders() {
 	structure.add("vertexPosition", Graphics4::Float3VertexData);
 	structure.add("texPosition", Graphics4::Float2VertexData);
 	structure.add("vertexColor", Graphics4::Float4VertexData);
+	addCompactStructure(compactStructure, true);
 
 	FileReader fs("painter-text.frag");
-	FileReader vs("painter-text.vert");
+	FileReader vs("painter-text-compact.vert");
 	Graphics4::Shader* fragmentShader = new Graphics4::Shader(fs.readAll(), fs.size(), Graphics4::FragmentShader);
 	Graphics4::Shader* vertexShader = new Graphics4::Shader(vs.readAll(), vs.size(), Graphics4::VertexShader);
 
@@ -605,120 +1073,129 @@ void Graphics2::TextShaderPainter::initShaders() {
 	shaderPipeline->alphaBlendSource = Graphics4::SourceAlpha;
 	shaderPipeline->alphaBlendDestination = Graphics4::InverseSourceAlpha;
 
-	shaderPipeline->inputLayout[0] = &structure;
+	shaderPipeline->inputLayout[0] = &compactStructure;
 	shaderPipeline->inputLayout[1] = nullptr;
 	shaderPipeline->compile();
 
 	projectionLocation = shaderPipeline->getConstantLocation("projectionMatrix");
 	textureLocation = shaderPipeline->getTextureUnit("tex");
+	myPipeline = shaderPipeline;
+
+	FileReader sdfFs("painter-text-sdf.frag");
+	sdfPipeline = new Graphics4::PipelineState();
+	sdfPipeline->fragmentShader = new Graphics4::Shader(sdfFs.readAll(), sdfFs.size(), Graphics4::FragmentShader);
+	sdfPipeline->vertexShader = vertexShader;
+	sdfPipeline->blendSource = shaderPipeline->blendSource;
+	sdfPipeline->blendDestination = shaderPipeline->blendDestination;
+	sdfPipeline->alphaBlendSource = shaderPipeline->alphaBlendSource;
+	sdfPipeline->alphaBlendDestination = shaderPipeline->alphaBlendDestination;
+	sdfPipeline->inputLayout[0] = &compactStructure;
+	sdfPipeline->inputLayout[1] = nullptr;
+	sdfPipeline->compile();
+
+	sdfProjectionLocation = sdfPipeline->getConstantLocation("projectionMatrix");
+	sdfTextureLocation = sdfPipeline->getTextureUnit("tex");
+	sdfRangeLocation = sdfPipeline->getConstantLocation("sdfRange");
 }
 
 void Graphics2::TextShaderPainter::initBuffers() {
-	rectVertexBuffer = new Graphics4::VertexBuffer(bufferSize * 4, structure);
-	rectVertices = rectVertexBuffer->lock();
-
-	indexBuffer = new Graphics4::IndexBuffer(bufferSize * 3 * 2);
-	int* indices = indexBuffer->lock();
-	for (int i = 0; i < bufferSize; ++i) {
-		indices[i * 3 * 2 + 0] = i * 4 + 0;
-		indices[i * 3 * 2 + 1] = i * 4 + 1;
-		indices[i * 3 * 2 + 2] = i * 4 + 2;
-		indices[i * 3 * 2 + 3] = i * 4 + 0;
-		indices[i * 3 * 2 + 4] = i * 4 + 2;
-		indices[i * 3 * 2 + 5] = i * 4 + 3;
-	}
-	indexBuffer->unlock();
+	rectVertexBuffer = new Graphics4::VertexBuffer(bufferSize * 4 * streamBatches, compactBuffers ? compactStructure : structure, Graphics4::DynamicUsage);
+	rectVertices = lockBatch(rectVertexBuffer, 0, bufferSize * 4);
+	streams[compactBuffers ? 1 : 0].buffer = rectVertexBuffer;
+
+	indexBuffer = new Graphics4::IndexBuffer(bufferSize * 3 * 2 * streamBatches);
+	initQuadIndices(indexBuffer, bufferSize * streamBatches);
+}
+
+// Custom pipelines expect the regular vertex layout, both layouts keep their vertex buffers.
+// Cached strings remember their vertex size, so the ones of the other layout are simply not replayed.
+void Graphics2::TextShaderPainter::updateLayout() {
+	bool compact = myPipeline == shaderPipeline;
+	if (compact == compactBuffers) return;
+	compactBuffers = compact;
+	vertexSize = compact ? 4 : 9;
+	bufferIndex = 0;
+	switchStream(streams, compact ? 0 : 1, compact ? 1 : 0, rectVertexBuffer, rectVertices, bufferStart, compact ? compactStructure : structure,
+	             bufferSize * 4);
 }
 
 void Graphics2::TextShaderPainter::setRectVertices(float bottomleftx, float bottomlefty, float topleftx, float toplefty, float toprightx, float toprighty,
                                         float bottomrightx, float bottomrighty) {
-	int baseIndex = bufferIndex * vertexSize * 4;
-	rectVertices[baseIndex + 0] = bottomleftx;
-	rectVertices[baseIndex + 1] = bottomlefty;
-	rectVertices[baseIndex + 2] = -5.0f; // TODO: should be 0?
-
-	rectVertices[baseIndex + 9] = topleftx;
-	rectVertices[baseIndex + 10] = toplefty;
-	rectVertices[baseIndex + 11] = -5.0;
-
-	rectVertices[baseIndex + 18] = toprightx;
-	rectVertices[baseIndex + 19] = toprighty;
-	rectVertices[baseIndex + 20] = -5.0;
-
-	rectVertices[baseIndex + 27] = bottomrightx;
-	rectVertices[baseIndex + 28] = bottomrighty;
-	rectVertices[baseIndex + 29] = -5.0;
+	float positions[] = {bottomleftx, bottomlefty, topleftx, toplefty, toprightx, toprighty, bottomrightx, bottomrighty};
+	setPositions(&rectVertices[bufferIndex * vertexSize * 4], vertexSize, compactBuffers, positions, 4);
 }
 
 void Graphics2::TextShaderPainter::setRectTexCoords(float left, float top, float right, float bottom) {
-	int baseIndex = bufferIndex * vertexSize * 4;
-	rectVertices[baseIndex + 3] = left;
-	rectVertices[baseIndex + 4] = bottom;
+	setTexCoords(&rectVertices[bufferIndex * vertexSize * 4], vertexSize, compactBuffers, left, top, right, bottom);
+}
 
-	rectVertices[baseIndex + 12] = left;
-	rectVertices[baseIndex + 13] = top;
+void Graphics2::TextShaderPainter::setRectColors(float opacity, uint color) {
+	setColors(&rectVertices[bufferIndex * vertexSize * 4], vertexSize, compactBuffers, compactBuffers ? 3 : 5, color, Color(color).A * opacity, 4);
+}
 
-	rectVertices[baseIndex + 21] = right;
-	rectVertices[baseIndex + 22] = top;
+void Graphics2::TextShaderPainter::drawBuffer(bool full) {
+	countFlush(stats, runLength, peakRunLength, bufferIndex, full);
+	rectVertexBuffer->unlock(bufferIndex * 4);
 
-	rectVertices[baseIndex + 30] = right;
-	rectVertices[baseIndex + 31] = bottom;
-}
+	// custom pipelines get distance field glyphs as they are
+	bool sdf = sdfBatch && myPipeline == shaderPipeline;
+	Graphics4::ConstantLocation projection = sdf ? sdfProjectionLocation : projectionLocation;
+	Graphics4::TextureUnit unit = sdf ? sdfTextureLocation : textureLocation;
+	Graphics4::TextureFilter filter = bilinear || sdf ? Graphics4::LinearFilter : Graphics4::PointFilter;
 
-void Graphics2::TextShaderPainter::setRectColors(float opacity, uint color) {
-	Color c = Color(color);
-	float r = c.R;
-	float g = c.G;
-	float b = c.B;
-	float a = c.A * opacity;
-
-	int baseIndex = bufferIndex * vertexSize * 4;
-	rectVertices[baseIndex + 5] = r;
-	rectVertices[baseIndex + 6] = g;
-	rectVertices[baseIndex + 7] = b;
-	rectVertices[baseIndex + 8] = a;
-
-	rectVertices[baseIndex + 14] = r;
-	rectVertices[baseIndex + 15] = g;
-	rectVertices[baseIndex + 16] = b;
-	rectVertices[baseIndex + 17] = a;
-
-	rectVertices[baseIndex + 23] = r;
-	rectVertices[baseIndex + 24] = g;
-	rectVertices[baseIndex + 25] = b;
-	rectVertices[baseIndex + 26] = a;
-
-	rectVertices[baseIndex + 32] = r;
-	rectVertices[baseIndex + 33] = g;
-	rectVertices[baseIndex + 34] = b;
-	rectVertices[baseIndex + 35] = a;
-}
-
-void Graphics2::TextShaderPainter::drawBuffer() {
-	rectVertexBuffer->unlock();
-	Graphics4::setPipeline(shaderPipeline);
+	Graphics4::setPipeline(sdf ? sdfPipeline : myPipeline);
 	Graphics4::setVertexBuffer(*rectVertexBuffer);
 	Graphics4::setIndexBuffer(*indexBuffer);
-	Graphics4::setTexture(textureLocation, lastTexture);
+	Graphics4::setTexture(unit, lastTexture);
 
     #ifndef KORE_G4
     // Set fixed-function projection matrix
     Graphics3::setProjectionMatrix(projectionMatrix);
     #else
     // Set shader matrix uniform
-	Graphics4::setMatrix(projectionLocation, projectionMatrix);
+	Graphics4::setMatrix(projection, projectionMatrix);
     #endif
+	if (sdf) Graphics4::setFloat2(sdfRangeLocation, sdfBatchRange);
 
-	Graphics4::setTextureAddressing(textureLocation, Graphics4::U, Graphics4::Clamp);
-	Graphics4::setTextureAddressing(textureLocation, Graphics4::V, Graphics4::Clamp);
-	Graphics4::setTextureMinificationFilter(textureLocation, bilinear ? Graphics4::LinearFilter : Graphics4::PointFilter);
-	Graphics4::setTextureMagnificationFilter(textureLocation, bilinear ? Graphics4::LinearFilter : Graphics4::PointFilter);
-	Graphics4::setTextureMipmapFilter(textureLocation, Graphics4::NoMipFilter);
+	Graphics4::setTextureAddressing(unit, Graphics4::U, Graphics4::Clamp);
+	Graphics4::setTextureAddressing(unit, Graphics4::V, Graphics4::Clamp);
+	Graphics4::setTextureMinificationFilter(unit, filter);
+	Graphics4::setTextureMagnificationFilter(unit, filter);
+	Graphics4::setTextureMipmapFilter(unit, Graphics4::NoMipFilter);
 
-	Graphics4::drawIndexedVertices(0, bufferIndex * 2 * 3);
+	Graphics4::drawIndexedVertices(bufferStart * 2 * 3, bufferIndex * 2 * 3);
 
+	bufferStart = nextBatchStart(bufferStart, bufferIndex, bufferSize);
 	bufferIndex = 0;
-	rectVertices = rectVertexBuffer->lock();
+	rectVertices = lockBatch(rectVertexBuffer, bufferStart * 4, bufferSize * 4);
+}
+
+void Graphics2::TextShaderPainter::setBufferSize(int size) {
+	size = clampBufferSize(size);
+	if (size == bufferSize) return;
+	end();
+	deleteStreams(streams, 2);
+	delete indexBuffer;
+	bufferSize = size;
+	bufferStart = 0;
+	initBuffers();
+}
+
+void Graphics2::TextShaderPainter::adaptBufferSize() {
+	setBufferSize(grownBufferSize(bufferSize, peakRunLength));
+	peakRunLength = 0;
+}
+
+int Graphics2::TextShaderPainter::getBufferSize() const {
+	return bufferSize;
+}
+
+const Graphics2::BatchStats& Graphics2::TextShaderPainter::getStats() const {
+	return stats;
+}
+
+void Graphics2::TextShaderPainter::resetStats() {
+	stats = BatchStats();
 }
 
 void Graphics2::TextShaderPainter::setBilinearFilter(bool bilinear) {
@@ -730,27 +1207,139 @@ void Graphics2::TextShaderPainter::setFont(Kravur* font) {
 	this->font = font;
 }
 
-// int TextShaderPainter::charCodeAt(int position) {}
+int Graphics2::TextShaderPainter::getLayoutCacheSize() const {
+	return layoutCacheSize;
+}
 
-// TODO: Make this fast
-int Graphics2::TextShaderPainter::findIndex(int charcode, int* fontGlyphs, int glyphCount) {
-	for (int index = 0; index < glyphCount; ++index) {
-		if (fontGlyphs[index] == charcode) return index;
+void Graphics2::TextShaderPainter::setLayoutCacheSize(int size) {
+	layoutCacheSize = size;
+	while ((int)layouts.size() > layoutCacheSize) {
+		layoutIndex.erase(layouts.back().hash);
+		layouts.pop_back();
+	}
+}
+
+const Graphics2::TextCacheStats& Graphics2::TextShaderPainter::getLayoutCacheStats() const {
+	return cacheStats;
+}
+
+void Graphics2::TextShaderPainter::resetLayoutCacheStats() {
+	cacheStats = TextCacheStats();
+}
+
+std::list<Graphics2::TextShaderPainter::TextLayout>::iterator Graphics2::TextShaderPainter::findLayout(u32 hash, const char* text, int length, uint color, float x,
+                                                                                                       float y, float scale, const mat3& transformation) {
+	std::unordered_map<u32, std::list<TextLayout>::iterator>::iterator it = layoutIndex.find(hash);
+	if (it == layoutIndex.end()) return layouts.end();
+	const TextLayout& layout = *it->second;
+	// a hash collision or a font which baked new glyphs or grew its texture since
+	if (layout.font != font || layout.generation != font->getGeneration() || layout.color != color || layout.x != x || layout.y != y ||
+	    layout.scale != scale || layout.vertexSize != vertexSize || layout.text.compare(0, std::string::npos, text, length) != 0 ||
+	    memcmp(&layout.transformation, &transformation, sizeof(mat3)) != 0) {
+		return layouts.end();
+	}
+	return it->second;
+}
+
+void Graphics2::TextShaderPainter::replayLayout(const TextLayout& layout) {
+	const float* source = layout.vertices.data();
+	int quads = layout.quads;
+	while (quads > 0) {
+		if (bufferIndex + 1 >= bufferSize) drawBuffer(true);
+		int count = Kore::min(quads, bufferSize - 1 - bufferIndex);
+		memcpy(&rectVertices[bufferIndex * vertexSize * 4], source, count * vertexSize * 4 * sizeof(float));
+		bufferIndex += count;
+		source += count * vertexSize * 4;
+		quads -= count;
 	}
-	return -1;
 }
 
-void Graphics2::TextShaderPainter::drawString(const char* text, int start, int length, float opacity, uint color, float x, float y, const mat3& transformation, int* fontGlyphs) {
+// The range only changes together with the texture, the atlas grows into a new one
+Graphics4::Texture* Graphics2::TextShaderPainter::useFontTexture() {
 	Graphics4::Texture* tex = font->getTexture();
 	if (lastTexture != nullptr && tex != lastTexture) drawBuffer();
 	lastTexture = tex;
+	float range = font->getSdfRange();
+	sdfBatchRange = vec2(range / font->width * tex->width / tex->texWidth, range / font->height * tex->height / tex->texHeight);
+	return tex;
+}
+
+// Glyphs which are not in the font texture yet are copied in before anything is drawn,
+// which can replace the texture so batched quads using the old one are flushed first.
+void Graphics2::TextShaderPainter::drawString(const char* text, int start, int length, float opacity, uint color, float x, float y, const mat3& transformation) {
+	const char* string = &text[start];
+	float scale = font->getScale(static_cast<float>(fontSize));
+
+	// distance field and bitmap glyphs need different shaders
+	if (bufferIndex > 0 && font->isSdf() != sdfBatch) drawBuffer();
+	sdfBatch = font->isSdf();
+
+	u32 hash = 0;
+	if (layoutCacheSize > 0) {
+		hash = hashBytes(2166136261u, string, length);
+		hash = hashBytes(hash, &font, sizeof(font));
+		hash = hashBytes(hash, &color, sizeof(color));
+		hash = hashBytes(hash, &x, sizeof(x));
+		hash = hashBytes(hash, &y, sizeof(y));
+		hash = hashBytes(hash, &scale, sizeof(scale));
+		hash = hashBytes(hash, &transformation, sizeof(mat3));
+		std::list<TextLayout>::iterator cached = findLayout(hash, string, length, color, x, y, scale, transformation);
+		if (cached != layouts.end()) {
+			++cacheStats.hits;
+			layouts.splice(layouts.begin(), layouts, cached);
+			useFontTexture();
+			replayLayout(*cached);
+			return;
+		}
+		++cacheStats.misses;
+	}
+
+	for (int i = 0; i < length;) {
+		int glyph = font->glyphIndex(Kravur::decodeUtf8(string, length, i));
+		if (font->needsBaking(glyph)) {
+			if (bufferIndex > 0) drawBuffer();
+			font->bakeGlyph(glyph);
+		}
+	}
+
+	Graphics4::Texture* tex = useFontTexture();
+
+	TextLayout* layout = nullptr;
+	if (layoutCacheSize > 0) {
+		std::unordered_map<u32, std::list<TextLayout>::iterator>::iterator old = layoutIndex.find(hash);
+		if (old != layoutIndex.end()) {
+			layouts.erase(old->second);
+			layoutIndex.erase(old);
+		}
+		else if ((int)layouts.size() >= layoutCacheSize) {
+			layoutIndex.erase(layouts.back().hash);
+			layouts.pop_back();
+			++cacheStats.evictions;
+		}
+		layouts.push_front(TextLayout());
+		layoutIndex[hash] = layouts.begin();
+		layout = &layouts.front();
+		layout->hash = hash;
+		layout->text.assign(string, length);
+		layout->font = font;
+		layout->generation = font->getGeneration();
+		layout->color = color;
+		layout->x = x;
+		layout->y = y;
+		layout->scale = scale;
+		layout->transformation = transformation;
+		layout->vertexSize = vertexSize;
+		layout->quads = 0;
+	}
 
 	float xpos = x;
 	float ypos = y;
-	for (int i = start; i < start + length; ++i) {
-		AlignedQuad q = font->getBakedQuad(text[i] - 32, xpos, ypos);
+	for (int i = 0; i < length;) {
+		int glyph = font->glyphIndex(Kravur::decodeUtf8(string, length, i));
+		if (glyph < 0) continue;
+		AlignedQuad q = font->getBakedQuad(glyph, xpos, ypos, scale);
 		if (q.x0 >= 0) {
-			if (bufferIndex + 1 >= bufferSize) drawBuffer();
+			if (bufferIndex + 1 >= bufferSize) drawBuffer(true);
 			setRectColors(1.0f, color);
 			setRectTexCoords(q.s0 * tex->width / tex->texWidth, q.t0 * tex->height / tex->texHeight, q.s1 * tex->width / tex->texWidth,
 			                 q.t1 * tex->height / tex->texHeight);
@@ -759,6 +1348,11 @@ void Graphics2::TextShaderPainter::drawString(const char* text, int start, int l
 			vec3 p2 = transformation * vec3(q.x1, q.y0, 1.0f); // top-right
 			vec3 p3 = transformation * vec3(q.x1, q.y1, 1.0f); // bottom-right
 			setRectVertices(p0.x(), p0.y(), p1.x(), p1.y(), p2.x(), p2.y(), p3.x(), p3.y());
+			if (layout != nullptr) {
+				float* vertices = &rectVertices[bufferIndex * vertexSize * 4];
+				layout->vertices.insert(layout->vertices.end(), vertices, vertices + vertexSize * 4);
+				++layout->quads;
+			}
 			xpos += q.xadvance;
 			++bufferIndex;
 		}
@@ -772,7 +1366,8 @@ void Graphics2::TextShaderPainter::end() {
 
 Graphics2::TextShaderPainter::~TextShaderPainter() {
 	delete shaderPipeline;
-	delete rectVertexBuffer;
+	delete sdfPipeline;
+	deleteStreams(streams, 2);
 	delete indexBuffer;
 }
 
@@ -780,13 +1375,19 @@ Graphics2::TextShaderPainter::~TextShaderPainter() {
 // Graphics2
 //==========
 
-Graphics2::Graphics2::Graphics2(int width, int height, bool rTargets): 
+Graphics2::Graphics2::Graphics2(int width, int height, bool rTargets, const BatchOptions& batchOptions): 
 	screenWidth(width), 
 	screenHeight(height), 
 	renderTargets(rTargets), 
 	color(Color::White), 
+	font(nullptr), 
 	fontColor(Color::Black), 
 	fontSize(14), 
+	atlas(nullptr), 
+	multiTextureBatching(false), 
+	adaptiveBatches(batchOptions.adaptive), 
+	deferred(false), 
+	layer(0), 
 	lastPipeline(nullptr), 
 	videoPipeline(nullptr) {
 	
@@ -796,9 +1397,9 @@ Graphics2::Graphics2::Graphics2(int width, int height, bool rTargets):
 	myImageScaleQuality = High;
 	myMipmapScaleQuality = High;
 
-	imagePainter = new ImageShaderPainter();
-	coloredPainter = new ColoredShaderPainter();
-	textPainter = new TextShaderPainter();
+	imagePainter = new ImageShaderPainter(batchOptions.imageBufferSize);
+	coloredPainter = new ColoredShaderPainter(batchOptions.coloredBufferSize, batchOptions.triangleBufferSize);
+	textPainter = new TextShaderPainter(batchOptions.textBufferSize);
 	textPainter->fontSize = fontSize;
 
 	setProjection();
@@ -874,81 +1475,57 @@ void Graphics2::Graphics2::pushRotation(float angle, float centerx, float center
 }
 
 void Graphics2::Graphics2::drawImage(Graphics4::Texture* img, float x, float y) {
-	coloredPainter->end();
-	textPainter->end();
-
-	float xw = x + img->width;
-	float yh = y + img->height;
-
-	float32x4 xx = load(x, x, xw, xw);
-	float32x4 yy = load(yh, y, y, yh);
-
-	float32x4 _00 = loadAll(transformation.get(0, 0));
-	float32x4 _01 = loadAll(transformation.get(1, 0));
-	float32x4 _02 = loadAll(transformation.get(2, 0));
-	float32x4 _10 = loadAll(transformation.get(0, 1));
-	float32x4 _11 = loadAll(transformation.get(1, 1));
-	float32x4 _12 = loadAll(transformation.get(2, 1));
-	float32x4 _20 = loadAll(transformation.get(0, 2));
-	float32x4 _21 = loadAll(transformation.get(1, 2));
-	float32x4 _22 = loadAll(transformation.get(2, 2));
-
-	// matrix multiply
-	float32x4 w = add(add(mul(_02, xx), mul(_12, yy)), _22);
-	float32x4 px = div(add(add(mul(_00, xx), mul(_10, yy)), _20), w);
-	float32x4 py = div(add(add(mul(_01, xx), mul(_11, yy)), _21), w);
-
-	imagePainter->drawImage(img, get(px, 0), get(py, 0), get(px, 1), get(py, 1), get(px, 2), get(py, 2), get(px, 3), get(py, 3), opacity, color);
+	drawScaledSubImage(img, 0, 0, static_cast<float>(img->width), static_cast<float>(img->height), x, y, static_cast<float>(img->width),
+	                   static_cast<float>(img->height));
 }
 
 void Graphics2::Graphics2::drawScaledSubImage(Graphics4::Texture* img, float sx, float sy, float sw, float sh, float dx, float dy, float dw, float dh) {
 	coloredPainter->end();
 	textPainter->end();
-	vec2 p1 = transformation * vec3(dx, dy + dh, 1.0f);
-	vec2 p2 = transformation * vec3(dx, dy, 1.0f);
-	vec2 p3 = transformation * vec3(dx + dw, dy, 1.0f);
-	vec2 p4 = transformation * vec3(dx + dw, dy + dh, 1.0f);
 
-	imagePainter->drawImage2(img, sx, sy, sw, sh, p1.x(), p1.y(), p2.x(), p2.y(), p3.x(), p3.y(), p4.x(), p4.y(), opacity, color);
+	if (deferred) {
+		float vertices[8];
+		quadVertices(dx, dy, dw, dh, vertices);
+		queueImage(img, nullptr, sx, sy, sw, sh, vertices);
+		return;
+	}
+
+	imagePainter->drawImageTransformed(img, sx, sy, sw, sh, dx, dy, dw, dh, transformation, opacity, color);
 }
 
-void Graphics2::Graphics2::drawImage(Graphics4::RenderTarget* img, float x, float y) {
+void Graphics2::Graphics2::drawSprites(Graphics4::Texture* img, const Sprite* sprites, int count) {
+	flushCommands();
 	coloredPainter->end();
 	textPainter->end();
+	imagePainter->drawSprites(img, sprites, count, transformation, opacity);
+}
 
-	float xw = x + img->width;
-	float yh = y + img->height;
-
-	float32x4 xx = load(x, x, xw, xw);
-	float32x4 yy = load(yh, y, y, yh);
-
-	float32x4 _00 = loadAll(transformation.get(0, 0));
-	float32x4 _01 = loadAll(transformation.get(1, 0));
-	float32x4 _02 = loadAll(transformation.get(2, 0));
-	float32x4 _10 = loadAll(transformation.get(0, 1));
-	float32x4 _11 = loadAll(transformation.get(1, 1));
-	float32x4 _12 = loadAll(transformation.get(2, 1));
-	float32x4 _20 = loadAll(transformation.get(0, 2));
-	float32x4 _21 = loadAll(transformation.get(1, 2));
-	float32x4 _22 = loadAll(transformation.get(2, 2));
-
-	// matrix multiply
-	float32x4 w = add(add(mul(_02, xx), mul(_12, yy)), _22);
-	float32x4 px = div(add(add(mul(_00, xx), mul(_10, yy)), _20), w);
-	float32x4 py = div(add(add(mul(_01, xx), mul(_11, yy)), _21), w);
-
-	imagePainter->drawImage(img, get(px, 0), get(py, 0), get(px, 1), get(py, 1), get(px, 2), get(py, 2), get(px, 3), get(py, 3), opacity, color);
+void Graphics2::Graphics2::drawImage(Graphics4::RenderTarget* img, float x, float y) {
+	drawScaledSubImage(img, 0, 0, static_cast<float>(img->width), static_cast<float>(img->height), x, y, static_cast<float>(img->width),
+	                   static_cast<float>(img->height));
 }
 
 void Graphics2::Graphics2::drawScaledSubImage(Graphics4::RenderTarget* img, float sx, float sy, float sw, float sh, float dx, float dy, float dw, float dh) {
 	coloredPainter->end();
 	textPainter->end();
-	vec2 p1 = transformation * vec3(dx, dy + dh, 1.0f);
-	vec2 p2 = transformation * vec3(dx, dy, 1.0f);
-	vec2 p3 = transformation * vec3(dx + dw, dy, 1.0f);
-	vec2 p4 = transformation * vec3(dx + dw, dy + dh, 1.0f);
 
-	imagePainter->drawImage2(img, sx, sy, sw, sh, p1.x(), p1.y(), p2.x(), p2.y(), p3.x(), p3.y(), p4.x(), p4.y(), opacity, color);
+	float v[8];
+	quadVertices(dx, dy, dw, dh, v);
+	if (deferred) {
+		queueImage(nullptr, img, sx, sy, sw, sh, v);
+		return;
+	}
+
+	imagePainter->drawImage2(img, sx, sy, sw, sh, v[0], v[1], v[2], v[3], v[4], v[5], v[6], v[7], opacity, color);
+}
+
+void Graphics2::Graphics2::quadVertices(float x, float y, float width, float height, float* vertices) {
+	float xs[4], ys[4];
+	transformQuad(transformation, x, y, x + width, y + height, xs, ys);
+	for (int i = 0; i < 4; ++i) {
+		vertices[i * 2 + 0] = xs[i];
+		vertices[i * 2 + 1] = ys[i];
+	}
 }
 
 void Graphics2::Graphics2::drawRect(float x, float y, float width, float height, float strength) {
@@ -959,36 +1536,39 @@ void Graphics2::Graphics2::drawRect(float x, float y, float width, float height,
 	vec2 p2 = transformation * vec3(x - strength / 2, y - strength / 2, 1.0f);                                // top-left
 	vec2 p3 = transformation * vec3(x + width + strength / 2, y - strength / 2, 1.0f);                        // top-right
 	vec2 p4 = transformation * vec3(x + width + strength / 2, y + strength / 2, 1.0f);                        // bottom-right
-	coloredPainter->fillRect(opacity, color, p1.x(), p1.y(), p2.x(), p2.y(), p3.x(), p3.y(), p4.x(), p4.y()); // top
+	fillQuad(p1, p2, p3, p4); // top
 
 	p1 = transformation * vec3(x - strength / 2, y + height - strength / 2, 1.0f);
 	p2 = transformation * vec3(x - strength / 2, y + strength / 2, 1.0f);
 	p3 = transformation * vec3(x + strength / 2, y + strength / 2, 1.0f);
 	p4 = transformation * vec3(x + strength / 2, y + height - strength / 2, 1.0f);
-	coloredPainter->fillRect(opacity, color, p1.x(), p1.y(), p2.x(), p2.y(), p3.x(), p3.y(), p4.x(), p4.y()); // left
+	fillQuad(p1, p2, p3, p4); // left
 
 	p1 = transformation * vec3(x - strength / 2, y + height + strength / 2, 1.0f);
 	p2 = transformation * vec3(x - strength / 2, y + height - strength / 2, 1.0f);
 	p3 = transformation * vec3(x + width + strength / 2, y + height - strength / 2, 1.0f);
 	p4 = transformation * vec3(x + width + strength / 2, y + height + strength / 2, 1.0f);
-	coloredPainter->fillRect(opacity, color, p1.x(), p1.y(), p2.x(), p2.y(), p3.x(), p3.y(), p4.x(), p4.y()); // bottom
+	fillQuad(p1, p2, p3, p4); // bottom
 
 	p1 = transformation * vec3(x + width - strength / 2, y + height - strength / 2, 1.0f);
 	p2 = transformation * vec3(x + width - strength / 2, y + strength / 2, 1.0f);
 	p3 = transformation * vec3(x + width + strength / 2, y + strength / 2, 1.0f);
 	p4 = transformation * vec3(x + width + strength / 2, y + height - strength / 2, 1.0f);
-	coloredPainter->fillRect(opacity, color, p1.x(), p1.y(), p2.x(), p2.y(), p3.x(), p3.y(), p4.x(), p4.y()); // right
+	fillQuad(p1, p2, p3, p4); // right
 }
 
 void Graphics2::Graphics2::fillRect(float x, float y, float width, float height) {
 	imagePainter->end();
 	textPainter->end();
 
-	vec2 p1 = transformation * vec3(x, y + height, 1.0f);
-	vec2 p2 = transformation * vec3(x, y, 1.0f);
-	vec2 p3 = transformation * vec3(x + width, y, 1.0f);
-	vec2 p4 = transformation * vec3(x + width, y + height, 1.0f);
-	coloredPainter->fillRect(opacity, color, p1.x(), p1.y(), p2.x(), p2.y(), p3.x(), p3.y(), p4.x(), p4.y());
+	if (deferred) {
+		float vertices[8];
+		quadVertices(x, y, width, height, vertices);
+		queueColored(Command::Rect, vertices, 4);
+		return;
+	}
+
+	coloredPainter->fillRectTransformed(opacity, color, x, y, width, height, transformation);
 }
 
 void Graphics2::Graphics2::drawString(const char* text, float x, float y) {
@@ -1001,10 +1581,33 @@ void Graphics2::Graphics2::drawString(const char* text, int length, float x, flo
 }
 
 void Graphics2::Graphics2::drawString(const char* text, int start, int length, float x, float y) {
+	if (deferred) {
+		queueString(text, start, length, x, y);
+		return;
+	}
+
 	imagePainter->end();
 	coloredPainter->end();
 
-	textPainter->drawString(text, start, length, opacity, fontColor, x, y, transformation, fontGlyphs);
+	textPainter->drawString(text, start, length, opacity, fontColor, x, y, transformation);
+}
+
+void Graphics2::Graphics2::fillQuad(const vec2& p1, const vec2& p2, const vec2& p3, const vec2& p4) {
+	if (deferred) {
+		float vertices[] = {p1.x(), p1.y(), p2.x(), p2.y(), p3.x(), p3.y(), p4.x(), p4.y()};
+		queueColored(Command::Rect, vertices, 4);
+		return;
+	}
+	coloredPainter->fillRect(opacity, color, p1.x(), p1.y(), p2.x(), p2.y(), p3.x(), p3.y(), p4.x(), p4.y());
+}
+
+void Graphics2::Graphics2::fillTri(const vec2& p1, const vec2& p2, const vec2& p3) {
+	if (deferred) {
+		float vertices[] = {p1.x(), p1.y(), p2.x(), p2.y(), p3.x(), p3.y()};
+		queueColored(Command::Triangle, vertices, 3);
+		return;
+	}
+	coloredPainter->fillTriangle(opacity, color, p1.x(), p1.y(), p2.x(), p2.y(), p3.x(), p3.y());
 }
 
 void Graphics2::Graphics2::drawLine(float x1, float y1, float x2, float y2, float strength) {
@@ -1027,8 +1630,8 @@ void Graphics2::Graphics2::drawLine(float x1, float y1, float x2, float y2, floa
 	p3 = transformation * p3;
 	p4 = transformation * p4;
 
-	coloredPainter->fillTriangle(opacity, color, p1.x(), p1.y(), p2.x(), p2.y(), p3.x(), p3.y());
-	coloredPainter->fillTriangle(opacity, color, p3.x(), p3.y(), p2.x(), p2.y(), p4.x(), p4.y());
+	fillTri(p1, p2, p3);
+	fillTri(p3, p2, p4);
 }
 
 void Graphics2::Graphics2::fillTriangle(float x1, float y1, float x2, float y2, float x3, float y3) {
@@ -1038,7 +1641,7 @@ void Graphics2::Graphics2::fillTriangle(float x1, float y1, float x2, float y2,
 	vec2 p1 = transformation * vec3(x1, y1, 1.0f);
 	vec2 p2 = transformation * vec3(x2, y2, 1.0f);
 	vec2 p3 = transformation * vec3(x3, y3, 1.0f);
-	coloredPainter->fillTriangle(opacity, color, p1.x(), p1.y(), p2.x(), p2.y(), p3.x(), p3.y());
+	fillTri(p1, p2, p3);
 }
 
 Graphics2::ImageScaleQuality Graphics2::Graphics2::getImageScaleQuality() const {
@@ -1046,6 +1649,7 @@ Graphics2::ImageScaleQuality Graphics2::Graphics2::getImageScaleQuality() const
 }
 
 void Graphics2::Graphics2::setImageScaleQuality(Kore::Graphics2::ImageScaleQuality value) {
+	flushCommands();
 	imagePainter->setBilinearFilter(value == High);
 	textPainter->setBilinearFilter(value == High);
 	myImageScaleQuality = value;
@@ -1056,6 +1660,7 @@ Graphics2::ImageScaleQuality Graphics2::Graphics2::getMipmapScaleQuality() const
 }
 
 void Graphics2::Graphics2::setMipmapScaleQuality(Kore::Graphics2::ImageScaleQuality value) {
+	flushCommands();
 	imagePainter->setBilinearMipmapFilter(value == High);
 	// textPainter->setBilinearMipmapFilter(value == High); // TODO (DK) implement for fonts as well?
 	myMipmapScaleQuality = value;
@@ -1097,6 +1702,7 @@ void Graphics2::Graphics2::clear(uint color) {
 }
 
 void Graphics2::Graphics2::flush() {
+	flushCommands();
 	imagePainter->end();
 	textPainter->end();
 	coloredPainter->end();
@@ -1104,6 +1710,11 @@ void Graphics2::Graphics2::flush() {
 
 void Graphics2::Graphics2::end() {
 	flush();
+	if (adaptiveBatches) {
+		imagePainter->adaptBufferSize();
+		coloredPainter->adaptBufferSize();
+		textPainter->adaptBufferSize();
+	}
 	//    Graphics::end();
 }
 
@@ -1115,6 +1726,229 @@ void Graphics2::Graphics2::drawVideo(/*Video video,*/ float x, float y, float wi
 	//    setPipeline(nullptr);
 }
 
+const Graphics2::BatchStats& Graphics2::Graphics2::getImageBatchStats() const {
+	return imagePainter->getStats();
+}
+
+const Graphics2::BatchStats& Graphics2::Graphics2::getColoredBatchStats() const {
+	return coloredPainter->getStats();
+}
+
+const Graphics2::BatchStats& Graphics2::Graphics2::getTextBatchStats() const {
+	return textPainter->getStats();
+}
+
+void Graphics2::Graphics2::resetBatchStats() {
+	imagePainter->resetStats();
+	coloredPainter->resetStats();
+	textPainter->resetStats();
+}
+
+int Graphics2::Graphics2::getTextLayoutCacheSize() const {
+	return textPainter->getLayoutCacheSize();
+}
+
+void Graphics2::Graphics2::setTextLayoutCacheSize(int size) {
+	textPainter->setLayoutCacheSize(size);
+}
+
+const Graphics2::TextCacheStats& Graphics2::Graphics2::getTextLayoutCacheStats() const {
+	return textPainter->getLayoutCacheStats();
+}
+
+void Graphics2::Graphics2::resetTextLayoutCacheStats() {
+	textPainter->resetLayoutCacheStats();
+}
+
+bool Graphics2::Graphics2::getDeferredDrawing() const {
+	return deferred;
+}
+
+void Graphics2::Graphics2::setDeferredDrawing(bool enabled) {
+	flushCommands();
+	deferred = enabled;
+}
+
+int Graphics2::Graphics2::getLayer() const {
+	return layer;
+}
+
+void Graphics2::Graphics2::setLayer(int layer) {
+	this->layer = layer;
+}
+
+void Graphics2::Graphics2::queueCommand(Command& command, const float* vertices, int count) {
+	command.layer = layer;
+	command.order = (int)commands.size();
+	command.opacity = opacity;
+	command.left = command.right = vertices[0];
+	command.top = command.bottom = vertices[1];
+	for (int i = 0; i < count; ++i) {
+		command.vertices[i * 2 + 0] = vertices[i * 2 + 0];
+		command.vertices[i * 2 + 1] = vertices[i * 2 + 1];
+		command.left = Kore::min(command.left, vertices[i * 2 + 0]);
+		command.right = Kore::max(command.right, vertices[i * 2 + 0]);
+		command.top = Kore::min(command.top, vertices[i * 2 + 1]);
+		command.bottom = Kore::max(command.bottom, vertices[i * 2 + 1]);
+	}
+	commands.push_back(command);
+}
+
+void Graphics2::Graphics2::queueImage(Graphics4::Texture* texture, Graphics4::RenderTarget* renderTarget, float sx, float sy, float sw, float sh,
+                                      const float* vertices) {
+	Command command;
+	command.type = texture != nullptr ? Command::Image : Command::RenderTargetImage;
+	command.color = color;
+	command.texture = texture;
+	command.renderTarget = renderTarget;
+	// With an atlas or multi texture batching differing textures can share a batch, so only the painter is compared
+	command.key = texture != nullptr ? (atlas != nullptr || multiTextureBatching ? nullptr : (void*)texture) : (void*)renderTarget;
+	command.sx = sx;
+	command.sy = sy;
+	command.sw = sw;
+	command.sh = sh;
+	queueCommand(command, vertices, 4);
+}
+
+void Graphics2::Graphics2::queueColored(Command::Type type, const float* vertices, int count) {
+	Command command;
+	command.type = type;
+	command.color = color;
+	command.key = nullptr;
+	queueCommand(command, vertices, count);
+}
+
+void Graphics2::Graphics2::queueString(const char* text, int start, int length, float x, float y) {
+	if (font == nullptr || length <= 0) return;
+	Command command;
+	command.type = Command::String;
+	command.font = font;
+	command.fontSize = fontSize;
+	command.key = font;
+	command.textStart = (int)commandText.size();
+	command.textLength = length;
+	commandText.insert(commandText.end(), &text[start], &text[start + length]);
+	command.x = x;
+	command.y = y;
+	command.transformation = transformation;
+	command.color = fontColor;
+
+	// glyphs can reach outside of the advance width and line height, so a line height is added on every side
+	float size = font->getHeight(static_cast<float>(fontSize));
+	float left = x - size;
+	float top = y - size;
+	float right = x + font->charsWidth(&commandText[command.textStart], 0, length, static_cast<float>(fontSize)) + size;
+	float bottom = y + size * 2;
+	vec2 p1 = transformation * vec3(left, bottom, 1.0f);
+	vec2 p2 = transformation * vec3(left, top, 1.0f);
+	vec2 p3 = transformation * vec3(right, top, 1.0f);
+	vec2 p4 = transformation * vec3(right, bottom, 1.0f);
+	float vertices[] = {p1.x(), p1.y(), p2.x(), p2.y(), p3.x(), p3.y(), p4.x(), p4.y()};
+	queueCommand(command, vertices, 4);
+}
+
+// Every command joins the earliest batch of the same kind that it can be moved to without changing
+// the result, which is any batch after the last batch it overlaps with. Layers are never mixed.
+void Graphics2::Graphics2::flushCommands() {
+	if (commands.empty()) return;
+
+	struct Batch {
+		Command::Type type;
+		void* key;
+		float left, top, right, bottom;
+	};
+	const int maxSearch = 64;
+
+	std::sort(commands.begin(), commands.end(), Command::byLayer);
+
+	std::vector<Batch> batches;
+	int layerStart = 0;
+	for (unsigned i = 0; i < commands.size(); ++i) {
+		Command& command = commands[i];
+		if (i > 0 && command.layer != commands[i - 1].layer) layerStart = (int)batches.size();
+
+		int batch = -1;
+		int lowest = Kore::max(layerStart, (int)batches.size() - maxSearch);
+		for (int b = (int)batches.size() - 1; b >= lowest; --b) {
+			Batch& other = batches[b];
+			if (other.type == command.type && other.key == command.key) batch = b;
+			if (other.left < command.right && command.left < other.right && other.top < command.bottom && command.top < other.bottom) break;
+		}
+
+		if (batch < 0) {
+			Batch added;
+			added.type = command.type;
+			added.key = command.key;
+			added.left = command.left;
+			added.top = command.top;
+			added.right = command.right;
+			added.bottom = command.bottom;
+			batch = (int)batches.size();
+			batches.push_back(added);
+		}
+		else {
+			Batch& joined = batches[batch];
+			joined.left = Kore::min(joined.left, command.left);
+			joined.top = Kore::min(joined.top, command.top);
+			joined.right = Kore::max(joined.right, command.right);
+			joined.bottom = Kore::max(joined.bottom, command.bottom);
+		}
+		command.batch = batch;
+	}
+
+	std::sort(commands.begin(), commands.end(), Command::byBatch);
+
+	for (unsigned i = 0; i < commands.size(); ++i) {
+		Command& command = commands[i];
+		const float* v = command.vertices;
+		switch (command.type) {
+		case Command::Image:
+			coloredPainter->end();
+			textPainter->end();
+			imagePainter->drawImage2(command.texture, command.sx, command.sy, command.sw, command.sh, v[0], v[1], v[2], v[3], v[4], v[5], v[6], v[7], command.opacity,
+			                         command.color);
+			break;
+		case Command::RenderTargetImage:
+			coloredPainter->end();
+			textPainter->end();
+			imagePainter->drawImage2(command.renderTarget, command.sx, command.sy, command.sw, command.sh, v[0], v[1], v[2], v[3], v[4], v[5], v[6], v[7],
+			                         command.opacity, command.color);
+			break;
+		case Command::Rect:
+			imagePainter->end();
+			textPainter->end();
+			coloredPainter->fillRect(command.opacity, command.color, v[0], v[1], v[2], v[3], v[4], v[5], v[6], v[7]);
+			break;
+		case Command::Triangle:
+			imagePainter->end();
+			textPainter->end();
+			coloredPainter->fillTriangle(command.opacity, command.color, v[0], v[1], v[2], v[3], v[4], v[5]);
+			break;
+		case Command::String:
+			imagePainter->end();
+			coloredPainter->end();
+			textPainter->setFont(command.font);
+			textPainter->fontSize = command.fontSize;
+			textPainter->drawString(&commandText[command.textStart], 0, command.textLength, command.opacity, command.color, command.x, command.y,
+			                        command.transformation);
+			break;
+		}
+	}
+	textPainter->setFont(font);
+	textPainter->fontSize = fontSize;
+
+	commands.clear();
+	commandText.clear();
+}
+
+bool Graphics2::Graphics2::getAdaptiveBatches() const {
+	return adaptiveBatches;
+}
+
+void Graphics2::Graphics2::setAdaptiveBatches(bool enabled) {
+	adaptiveBatches = enabled;
+}
+
 uint Graphics2::Graphics2::getColor() const {
 	return color;
 }
@@ -1131,6 +1965,26 @@ void Graphics2::Graphics2::setOpacity(float opacity) {
 	this->opacity = opacity;
 }
 
+Graphics2::TextureAtlas* Graphics2::Graphics2::getTextureAtlas() const {
+	return atlas;
+}
+
+void Graphics2::Graphics2::setTextureAtlas(TextureAtlas* atlas) {
+	flushCommands();
+	imagePainter->setAtlas(atlas);
+	this->atlas = atlas;
+}
+
+bool Graphics2::Graphics2::getMultiTextureBatching() const {
+	return multiTextureBatching;
+}
+
+void Graphics2::Graphics2::setMultiTextureBatching(bool enabled) {
+	flushCommands();
+	imagePainter->setMultiTextureBatching(enabled);
+	multiTextureBatching = enabled;
+}
+
 Kravur* Graphics2::Graphics2::getFont() const {
 	return font;
 }
@@ -1146,6 +2000,7 @@ int Graphics2::Graphics2::getFontSize() const {
 
 void Graphics2::Graphics2::setFontSize(int value) {
 	this->fontSize = value;
+	textPainter->fontSize = value;
 }
 
 uint Graphics2::Graphics2::getFontColor() const {
@@ -1,35 +1,125 @@
 #pragma once
 
 #include "Kravur.h"
+#include "TextureAtlas.h"
 #include <Kore/Graphics1/Color.h>
 #include <Kore/Graphics4/PipelineState.h>
 #include <Kore/Math/Matrix.h>
 
+#include <list>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
 namespace Kore {
 	namespace Graphics2 {
 		class Graphics2;
 
 		typedef Kore::Graphics1::Color Color;
 
+		// Buffer sizes are counted in quads (triangles for triangleBufferSize) and are limited to 4096
+		struct BatchOptions {
+			BatchOptions() : imageBufferSize(1500), coloredBufferSize(100), triangleBufferSize(100), textBufferSize(100), adaptive(false) {}
+
+			int imageBufferSize;
+			int coloredBufferSize;
+			int triangleBufferSize;
+			int textBufferSize;
+			bool adaptive; // grows the buffers at the end of a frame when batches had to be split because they were full
+		};
+
+		struct BatchStats {
+			BatchStats() : capacityFlushes(0), stateFlushes(0) {}
+
+			int capacityFlushes; // batches which were drawn because the buffer was full
+			int stateFlushes;    // batches which were drawn because of a texture, pipeline or painter switch or the end of the frame
+		};
+
+		struct TextCacheStats {
+			TextCacheStats() : hits(0), misses(0), evictions(0) {}
+
+			int hits;
+			int misses;
+			int evictions;
+
+			float hitRate() const {
+				return hits + misses > 0 ? hits / (float)(hits + misses) : 0.0f;
+			}
+		};
+
+		// One sprite of Graphics2::drawSprites, source and destination rectangles are in pixels
+		struct Sprite {
+			float sx, sy, sw, sh;
+			float dx, dy, dw, dh;
+			uint color;
+		};
+
+		// A painter's vertex buffer for one vertex layout, kept locked at its next batch while another layout is used
+		struct VertexStream {
+			VertexStream() : buffer(nullptr), vertices(nullptr), start(0) {}
+
+			Graphics4::VertexBuffer* buffer;
+			float* vertices;
+			int start;
+		};
+
 		class ImageShaderPainter {
+		public:
+			static const int maxTextureSlots = 8;
+
 		private:
 			mat4 projectionMatrix;
 
 			Graphics4::PipelineState* shaderPipeline;
 			Graphics4::VertexStructure structure;
+			Graphics4::VertexStructure compactStructure;
 			Graphics4::ConstantLocation projectionLocation;
 			Graphics4::TextureUnit textureLocation;
 
+			// painter-image-indexed, selects one of several bound textures per vertex
+			Graphics4::PipelineState* indexedPipeline;
+			Graphics4::VertexStructure indexedStructure;
+			Graphics4::ConstantLocation indexedProjectionLocation;
+			Graphics4::TextureUnit textureLocations[maxTextureSlots];
+			Graphics4::Texture* textures[maxTextureSlots];
+			int textureCount;
+			bool multiTexture;
+			bool compactBuffers;
+			bool indexedBuffers;
+
+			// painter-image-instanced, draws a unit quad once per sprite record
+			Graphics4::PipelineState* instancedPipeline;
+			Graphics4::VertexStructure quadStructure;
+			Graphics4::VertexStructure instanceStructure;
+			Graphics4::ConstantLocation instancedProjectionLocation;
+			Graphics4::TextureUnit instancedTextureLocation;
+			Graphics4::VertexBuffer* quadVertexBuffer;
+			Graphics4::IndexBuffer* quadIndexBuffer;
+			Graphics4::VertexBuffer* instanceBuffer;
+			float* instances;
+			int instanceBufferSize;
+			int instanceIndex;
+			Graphics4::Texture* instanceTexture;
+
 			int bufferSize;
 			int vertexSize;
+			int bufferStart;
 			int bufferIndex;
 			Graphics4::VertexBuffer* rectVertexBuffer;
 			float* rectVertices;
 			Graphics4::IndexBuffer* indexBuffer;
+			VertexStream streams[3]; // regular, compact and indexed layout
+
+			BatchStats stats;
+			int runLength;
+			int peakRunLength;
 
 			Graphics4::Texture* lastTexture;
 			Graphics4::RenderTarget* lastRenderTarget;
 
+			TextureAtlas* atlas;
+			Graphics4::Texture* lastImage;
+
 			bool bilinear;
 			bool bilinearMipmaps;
 
@@ -39,16 +129,29 @@ namespace Kore {
 			Graphics4::BlendingOperation destinationBlend; // = Undefined;
 
 			void initShaders();
+			void initIndexedShaders();
+			void initInstancedShaders();
 			void initBuffers();
+			void updateLayout();
 
 			void setRectVertices(float bottomleftx, float bottomlefty, float topleftx, float toplefty, float toprightx, float toprighty, float bottomrightx,
 			                     float bottomrighty);
 			void setRectTexCoords(float left, float top, float right, float bottom);
-			void setRectColor(float r, float g, float b, float a);
-			void drawBuffer();
+			void setRectColor(uint color, float alpha);
+			void setRectTexIndex(float index);
+			void setTextureParameters(Graphics4::TextureUnit unit);
+			void setTexture(Graphics4::TextureUnit unit, Graphics4::Texture* texture);
+			void drawBuffer(bool full = false);
+			void drawInstances();
+			void endInstances();
+
+			Graphics4::Texture* useAtlas(Graphics4::Texture* img, float& sx, float& sy);
+			bool breaksBatch(Graphics4::Texture* tex);
+			int findTextureSlot(Graphics4::Texture* tex);
+			void useTextureSlot(Graphics4::Texture* tex);
 
 		public:
-			ImageShaderPainter();
+			ImageShaderPainter(int bufferSize = 1500);
 			~ImageShaderPainter();
 
 			Graphics4::PipelineState* get_pipeline() const;
@@ -59,6 +162,18 @@ namespace Kore {
 			void setBilinearFilter(bool bilinear);
 			void setBilinearMipmapFilter(bool bilinear);
 
+			int getBufferSize() const;
+			void setBufferSize(int size);
+			// Grows the buffer to fit the longest batch seen since the last call
+			void adaptBufferSize();
+
+			const BatchStats& getStats() const;
+			void resetStats();
+
+			void setAtlas(TextureAtlas* atlas);
+			// Binds up to maxTextureSlots textures per batch, only used with the default pipeline
+			void setMultiTextureBatching(bool enabled);
+
 			inline void drawImage(Graphics4::Texture* img, float bottomleftx, float bottomlefty, float topleftx, float toplefty, float toprightx,
 			                      float toprighty, float bottomrightx, float bottomrighty, float opacity, uint color);
 			inline void drawImage2(Graphics4::Texture* img, float sx, float sy, float sw, float sh, float bottomleftx, float bottomlefty, float topleftx,
@@ -73,6 +188,12 @@ namespace Kore {
 			inline void drawImageScale(Graphics4::RenderTarget* img, float sx, float sy, float sw, float sh, float left, float top, float right, float bottom,
 			                           float opacity, uint color);
 
+			// Transforms the destination rectangle and writes the quad straight into the vertex buffer
+			inline void drawImageTransformed(Graphics4::Texture* img, float sx, float sy, float sw, float sh, float dx, float dy, float dw, float dh,
+			                                 const mat3& transformation, float opacity, uint color);
+
+			void drawSprites(Graphics4::Texture* img, const Sprite* sprites, int count, const mat3& transformation, float opacity);
+
 			void end();
 		};
 
@@ -81,20 +202,32 @@ namespace Kore {
 			mat4 projectionMatrix;
 			Graphics4::PipelineState* shaderPipeline;
 			Graphics4::VertexStructure structure;
+			Graphics4::VertexStructure compactStructure;
 			Graphics4::ConstantLocation projectionLocation;
+			bool compactBuffers;
 
 			int bufferSize;
 			int vertexSize;
+			int bufferStart;
 			int bufferIndex;
 			Graphics4::VertexBuffer* rectVertexBuffer;
 			float* rectVertices;
 			Graphics4::IndexBuffer* indexBuffer;
+			VertexStream rectStreams[2]; // regular and compact layout
 
 			int triangleBufferSize;
+			int triangleBufferStart;
 			int triangleBufferIndex;
 			Graphics4::VertexBuffer* triangleVertexBuffer;
 			float* triangleVertices;
 			Graphics4::IndexBuffer* triangleIndexBuffer;
+			VertexStream triangleStreams[2];
+
+			BatchStats stats;
+			int runLength;
+			int peakRunLength;
+			int triangleRunLength;
+			int triangleRunPeak;
 
 			Graphics4::PipelineState* myPipeline;
 
@@ -103,19 +236,29 @@ namespace Kore {
 
 			void initShaders();
 			void initBuffers();
+			void updateLayout();
 
 			void setTriVertices(float x1, float y1, float x2, float y2, float x3, float y3);
 			void setTriColors(float opacity, uint color);
-			void drawBuffer(bool trisDone);
-			void drawTriBuffer(bool rectsDone);
+			void drawBuffer(bool trisDone, bool full = false);
+			void drawTriBuffer(bool rectsDone, bool full = false);
 
 		public:
-			ColoredShaderPainter();
+			ColoredShaderPainter(int bufferSize = 100, int triangleBufferSize = 100);
 			~ColoredShaderPainter();
 
 			Graphics4::PipelineState* get_pipeline() const;
 			void set_pipeline(Graphics4::PipelineState* pipe);
 
+			int getBufferSize() const;
+			int getTriangleBufferSize() const;
+			void setBufferSizes(int size, int triangleSize);
+			// Grows the buffers to fit the longest batches seen since the last call
+			void adaptBufferSize();
+
+			const BatchStats& getStats() const;
+			void resetStats();
+
 			void setProjection(mat4 projectionMatrix);
 
 			void setRectVertices(float bottomleftx, float bottomlefty, float topleftx, float toplefty, float toprightx, float toprighty, float bottomrightx,
@@ -124,6 +267,7 @@ namespace Kore {
 
 			void fillRect(float opacity, uint color, float bottomleftx, float bottomlefty, float topleftx, float toplefty, float toprightx, float toprighty,
 			              float bottomrightx, float bottomrighty);
+			void fillRectTransformed(float opacity, uint color, float x, float y, float width, float height, const mat3& transformation);
 			void fillTriangle(float opacity, uint color, float x1, float y1, float x2, float y2, float x3, float y3);
 
 			inline void endTris(bool rectsDone);
@@ -137,15 +281,50 @@ namespace Kore {
 			mat4 projectionMatrix;
 			Graphics4::PipelineState* shaderPipeline;
 			Graphics4::VertexStructure structure;
+			Graphics4::VertexStructure compactStructure;
 			Graphics4::ConstantLocation projectionLocation;
 			Graphics4::TextureUnit textureLocation;
+			bool compactBuffers;
+
+			// Used instead of shaderPipeline while the batch holds signed distance field glyphs
+			Graphics4::PipelineState* sdfPipeline;
+			Graphics4::ConstantLocation sdfProjectionLocation;
+			Graphics4::TextureUnit sdfTextureLocation;
+			Graphics4::ConstantLocation sdfRangeLocation;
+			bool sdfBatch;
+			vec2 sdfBatchRange; // of the font whose glyphs are batched, in texture coordinates
 
 			int bufferSize;
+			int bufferStart;
 			int bufferIndex;
 			int vertexSize;
 			Graphics4::VertexBuffer* rectVertexBuffer;
 			float* rectVertices;
 			Graphics4::IndexBuffer* indexBuffer;
+			VertexStream streams[2]; // regular and compact layout
+
+			BatchStats stats;
+			int runLength;
+			int peakRunLength;
+
+			// Finished vertices of recently drawn strings, most recently used first
+			struct TextLayout {
+				u32 hash;
+				std::string text;
+				Kravur* font;
+				u32 generation;
+				uint color;
+				float x, y;
+				float scale;
+				mat3 transformation;
+				int vertexSize;
+				int quads;
+				std::vector<float> vertices;
+			};
+			std::list<TextLayout> layouts;
+			std::unordered_map<u32, std::list<TextLayout>::iterator> layoutIndex;
+			int layoutCacheSize;
+			TextCacheStats cacheStats;
 
 			Kravur* font;
 
@@ -160,34 +339,50 @@ namespace Kore {
 
 			void initShaders();
 			void initBuffers();
+			void updateLayout();
 
 			void setRectVertices(float bottomleftx, float bottomlefty, float topleftx, float toplefty, float toprightx, float toprighty, float bottomrightx,
 			                     float bottomrighty);
 			void setRectTexCoords(float left, float top, float right, float bottom);
 			void setRectColors(float opacity, uint color);
-			void drawBuffer();
-
-			char* text;
-			int charCodeAt(int position);
+			void drawBuffer(bool full = false);
 
-			int findIndex(int charcode, int* fontGlyphs, int glyphCount);
+			std::list<TextLayout>::iterator findLayout(u32 hash, const char* text, int length, uint color, float x, float y, float scale,
+			                                          const mat3& transformation);
+			void replayLayout(const TextLayout& layout);
+			Graphics4::Texture* useFontTexture();
 
 		public:
-			TextShaderPainter();
+			TextShaderPainter(int bufferSize = 100);
 			~TextShaderPainter();
 
-			int fontSize;
+			int fontSize; // only used by signed distance field fonts
 
 			Graphics4::PipelineState* get_pipeline() const;
 			void set_pipeline(Graphics4::PipelineState* pipe);
 
+			int getBufferSize() const;
+			void setBufferSize(int size);
+			// Grows the buffer to fit the longest batch seen since the last call
+			void adaptBufferSize();
+
+			const BatchStats& getStats() const;
+			void resetStats();
+
 			void setProjection(mat4 projectionMatrix);
 
 			void setBilinearFilter(bool bilinear);
 
 			void setFont(Kravur* font);
 
-			void drawString(const char* text, int start, int length, float opacity, uint color, float x, float y, const mat3& transformation, int* fontGlyphs);
+			// Number of strings whose vertices are kept for replaying, 0 disables the cache
+			int getLayoutCacheSize() const;
+			void setLayoutCacheSize(int size);
+			const TextCacheStats& getLayoutCacheStats() const;
+			void resetLayoutCacheStats();
+
+			// text is UTF-8, start and length are in bytes
+			void drawString(const char* text, int start, int length, float opacity, uint color, float x, float y, const mat3& transformation);
 
 			void end();
 		};
@@ -209,9 +404,50 @@ namespace Kore {
 			int fontSize;
 			uint fontColor;
 
-			mat4 projectionMatrix;
+			TextureAtlas* atlas;
+			bool multiTextureBatching;
+			bool adaptiveBatches;
+
+			// A draw call recorded in deferred mode, positions are already transformed
+			struct Command {
+				enum Type { Image, RenderTargetImage, Rect, Triangle, String };
+
+				Type type;
+				int layer;
+				int order;
+				int batch;
+				void* key; // commands of the same type and key are drawn in one batch
+				float left, top, right, bottom;
+				float vertices[8];
+				uint color;
+				float opacity;
+
+				Graphics4::Texture* texture;
+				Graphics4::RenderTarget* renderTarget;
+				float sx, sy, sw, sh;
+
+				Kravur* font;
+				int fontSize;
+				int textStart;
+				int textLength;
+				float x, y;
+				mat3 transformation;
+
+				static bool byLayer(const Command& a, const Command& b) {
+					return a.layer < b.layer || (a.layer == b.layer && a.order < b.order);
+				}
+
+				static bool byBatch(const Command& a, const Command& b) {
+					return a.batch < b.batch || (a.batch == b.batch && a.order < b.order);
+				}
+			};
+
+			bool deferred;
+			int layer;
+			std::vector<Command> commands;
+			std::vector<char> commandText;
 
-			int* fontGlyphs;
+			mat4 projectionMatrix;
 
 			ImageShaderPainter* imagePainter;
 			ColoredShaderPainter* coloredPainter;
@@ -230,8 +466,18 @@ namespace Kore {
 
 			void initShaders();
 
+			void quadVertices(float x, float y, float width, float height, float* vertices);
+			void fillQuad(const vec2& p1, const vec2& p2, const vec2& p3, const vec2& p4);
+			void fillTri(const vec2& p1, const vec2& p2, const vec2& p3);
+
+			void queueCommand(Command& command, const float* vertices, int count);
+			void queueImage(Graphics4::Texture* texture, Graphics4::RenderTarget* renderTarget, float sx, float sy, float sw, float sh, const float* vertices);
+			void queueColored(Command::Type type, const float* vertices, int count);
+			void queueString(const char* text, int start, int length, float x, float y);
+			void flushCommands();
+
 		public:
-			Graphics2(int width, int height, bool rTargets = false);
+			Graphics2(int width, int height, bool rTargets = false, const BatchOptions& batchOptions = BatchOptions());
 			~Graphics2();
 
 			mat3 transformation;
@@ -244,6 +490,10 @@ namespace Kore {
 			void drawImage(Graphics4::RenderTarget* img, float x, float y);
 			void drawScaledSubImage(Graphics4::RenderTarget* img, float sx, float sy, float sw, float sh, float dx, float dy, float dw, float dh);
 
+			// Draws many sprites of one image using a single instance record per sprite
+			// instead of four vertices. Sprite colors are multiplied with the opacity.
+			void drawSprites(Graphics4::Texture* img, const Sprite* sprites, int count);
+
 			void drawRect(float x, float y, float width, float height, float strength = 1.0);
 			void fillRect(float x, float y, float width, float height);
 
@@ -280,6 +530,39 @@ namespace Kore {
 			ImageScaleQuality getMipmapScaleQuality() const;
 			void setMipmapScaleQuality(ImageScaleQuality value);
 
+			// Small readable images are drawn from the atlas when one is set, so switching between them does not break batches
+			TextureAtlas* getTextureAtlas() const;
+			void setTextureAtlas(TextureAtlas* atlas);
+
+			// Lets image batches switch between several textures without flushing
+			bool getMultiTextureBatching() const;
+			void setMultiTextureBatching(bool enabled);
+
+			// Flush counters of the painters since the last reset
+			const BatchStats& getImageBatchStats() const;
+			const BatchStats& getColoredBatchStats() const;
+			const BatchStats& getTextBatchStats() const;
+			void resetBatchStats();
+
+			// Repeated drawString calls with the same text, font, color, position and transformation
+			// replay the glyph quads of an earlier call
+			int getTextLayoutCacheSize() const;
+			void setTextLayoutCacheSize(int size);
+			const TextCacheStats& getTextLayoutCacheStats() const;
+			void resetTextLayoutCacheStats();
+
+			// Records draw calls and reorders them at flush/end so calls of the same painter and texture
+			// are drawn together, calls are only moved past each other when they do not overlap
+			bool getDeferredDrawing() const;
+			void setDeferredDrawing(bool enabled);
+
+			// Deferred calls of lower layers are drawn first
+			int getLayer() const;
+			void setLayer(int layer);
+
+			bool getAdaptiveBatches() const;
+			void setAdaptiveBatches(bool enabled);
+
 			Kravur* getFont() const;
 			void setFont(Kravur* font);
 			int getFontSize() const;
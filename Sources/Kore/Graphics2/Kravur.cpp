@@ -3,6 +3,8 @@
 #include "Kravur.h"
 
 #include <Kore/IO/FileReader.h>
+#include <Kore/Log.h>
+#include <Kore/Simd/float32x4.h>
 #include <map>
 #include <sstream>
 #include <string.h>
@@ -14,6 +16,20 @@ using namespace Kore;
 namespace {
 	std::map<std::string, Kravur*> fontCache;
 
+	// Font container, little endian. Sections start at multiples of 16 bytes and atlas levels at multiples
+	// of 4096 so they are page aligned when the file is mapped.
+	// header: u32 magic, u32 version, u32 flags, u32 glyph count, f32 size, f32 ascent, f32 descent, f32 line gap,
+	//         f32 sdf range, u32 level count, u32 glyph table offset, u32 reserved
+	// levels: u32 width, u32 height, u32 offset, u32 reserved per level, largest first, each half the size of the previous
+	// glyphs: s32 codepoint, s16 x0, y0, x1, y1 in pixels of the largest level, f32 xoff, yoff, xadvance per glyph
+	const u32 containerMagic = 0x4656524b; // "KRVF"
+	const u32 containerVersion = 1;
+	const u32 containerSdf = 1;
+	const int containerHeaderSize = 48;
+	const int containerLevelSize = 16;
+	const int containerGlyphSize = 24;
+	const int maxTextureSize = 4096;
+
 	std::string createKey(const char* name, FontStyle style, float size) {
 		std::stringstream key;
 		key << name;
@@ -27,6 +43,19 @@ namespace {
 		key << ".kravur";
 		return key.str();
 	}
+
+	std::string createSdfKey(const char* name, FontStyle style) {
+		std::stringstream key;
+		key << name;
+		if (style.bold) {
+			key << "#Bold";
+		}
+		if (style.italic) {
+			key << "#Italic";
+		}
+		key << ".sdf.kravur";
+		return key.str();
+	}
 }
 
 Kravur* Kravur::load(const char* name, FontStyle style, float size) {
@@ -48,11 +77,41 @@ Kravur* Kravur::load(const char* name, FontStyle style, float size) {
 	}
 }
 
-Kravur::Kravur(Reader* reader) {
-	reader->readS32LE(); // size
+Kravur* Kravur::loadSdf(const char* name, FontStyle style) {
+	std::string key = createSdfKey(name, style);
+	Kravur* kravur = fontCache[key];
+	if (kravur == nullptr) {
+		FileReader reader(key.c_str());
+		kravur = new Kravur(&reader, true);
+		kravur->name = name;
+		kravur->style = style;
+
+		fontCache[key] = kravur;
+	}
+	return kravur;
+}
+
+// SDF fonts use the same layout with the distance range as a float after lineGap,
+// their glyph boxes include the range and the texture stores distances mapped to 0-255 with the edge at 128.
+Kravur::Kravur(Reader* reader, bool sdf) : sdf(sdf), sdfRange(0), unbaked(0), shelfX(0), shelfY(0), shelfHeight(0), dirty(false), generation(0) {
+	for (int i = 0; i < 256; ++i) {
+		latinGlyphs[i] = -1;
+		latinAdvances[i] = 0;
+	}
+
+	// regular files start with the font size which can never be mistaken for the magic number
+	if (reader->size() >= containerHeaderSize && reader->readU32LE() == containerMagic) {
+		readContainer(reader);
+		reader->seek(0);
+		return;
+	}
+	reader->seek(0);
+
+	size = static_cast<float>(reader->readS32LE());
 	int ascent = reader->readS32LE();
 	reader->readS32LE(); // descent
 	reader->readS32LE(); // lineGap
+	if (sdf) sdfRange = reader->readF32LE();
 	baseline = static_cast<float>(ascent);
 	for (int i = 0; i < 256 - 32; ++i) {
 		BakedChar c;
@@ -63,82 +122,362 @@ Kravur::Kravur(Reader* reader) {
 		c.xoff = reader->readF32LE();
 		c.yoff = reader->readF32LE() + baseline;
 		c.xadvance = reader->readF32LE();
-		chars.push_back(c);
+		addGlyph(i + 32, c);
 	}
 	width = reader->readS32LE();
 	height = reader->readS32LE();
 	int w = width;
 	int h = height;
-	while (w > 4096 || h > 4096) {
+	while (w > maxTextureSize || h > maxTextureSize) {
 		reader->seek(reader->pos() + h * w);
 		w = w / 2;
 		h = h / 2;
 	}
+	atlas.resize(w * h);
+	reader->read(atlas.data(), w * h);
+
+	// Optional glyphs beyond Latin-1 which are copied into the texture when they are first used:
+	// count, then per glyph codepoint, width, height, xoff, yoff, xadvance and the Grey8 pixels
+	if (reader->pos() + 4 <= reader->size()) {
+		int count = reader->readS32LE();
+		for (int i = 0; i < count; ++i) {
+			int codepoint = reader->readS32LE();
+			PendingGlyph glyph;
+			glyph.width = reader->readS16LE();
+			glyph.height = reader->readS16LE();
+			BakedChar c;
+			c.xoff = reader->readF32LE();
+			c.yoff = reader->readF32LE() + baseline;
+			c.xadvance = reader->readF32LE();
+			glyph.offset = static_cast<int>(pendingPixels.size());
+			pendingPixels.resize(pendingPixels.size() + glyph.width * glyph.height);
+			reader->read(&pendingPixels[glyph.offset], glyph.width * glyph.height);
+			addGlyph(codepoint, c);
+			pending.back() = glyph;
+			++unbaked;
+		}
+	}
+	uploadLevel(atlas.data(), w, h);
+	reader->seek(0);
+}
+
+// Parses the header and both tables straight out of the mapped file and uploads the selected atlas level from it
+void Kravur::readContainer(Reader* reader) {
+	u8* data = (u8*)reader->map();
+	int fileSize = reader->size();
+	u32 version = Reader::readU32LE(&data[4]);
+	u32 flags = Reader::readU32LE(&data[8]);
+	int glyphCount = Reader::readS32LE(&data[12]);
+	size = Reader::readF32LE(&data[16]);
+	baseline = Reader::readF32LE(&data[20]);
+	sdf = sdf || (flags & containerSdf) != 0;
+	sdfRange = Reader::readF32LE(&data[32]);
+	int levelCount = Reader::readS32LE(&data[36]);
+	int glyphTable = Reader::readS32LE(&data[40]);
+
+	u8* levels = &data[containerHeaderSize];
+	int level = 0;
+	bool valid = version <= containerVersion && levelCount >= 1 && glyphTable >= containerHeaderSize + levelCount * containerLevelSize &&
+	             glyphTable + glyphCount * containerGlyphSize <= fileSize;
+	if (valid) {
+		while (level + 1 < levelCount && (Reader::readS32LE(&levels[level * containerLevelSize]) > maxTextureSize ||
+		                                  Reader::readS32LE(&levels[level * containerLevelSize + 4]) > maxTextureSize)) {
+			++level;
+		}
+		u8* selected = &levels[level * containerLevelSize];
+		valid = Reader::readS32LE(&selected[8]) + Reader::readS32LE(&selected[0]) * Reader::readS32LE(&selected[4]) <= fileSize;
+	}
+
+	width = height = 1;
+	if (!valid) {
+		log(Error, "Unsupported or broken font container.");
+		u8 empty = 0;
+		uploadLevel(&empty, 1, 1);
+		return;
+	}
+
+	width = Reader::readS32LE(&levels[0]);
+	height = Reader::readS32LE(&levels[4]);
+
+	chars.reserve(glyphCount);
+	pending.reserve(glyphCount);
+	u8* glyph = &data[glyphTable];
+	for (int i = 0; i < glyphCount; ++i, glyph += containerGlyphSize) {
+		BakedChar c;
+		c.x0 = Reader::readS16LE(&glyph[4]);
+		c.y0 = Reader::readS16LE(&glyph[6]);
+		c.x1 = Reader::readS16LE(&glyph[8]);
+		c.y1 = Reader::readS16LE(&glyph[10]);
+		c.xoff = Reader::readF32LE(&glyph[12]);
+		c.yoff = Reader::readF32LE(&glyph[16]) + baseline;
+		c.xadvance = Reader::readF32LE(&glyph[20]);
+		addGlyph(Reader::readS32LE(&glyph[0]), c);
+	}
+
+	u8* selected = &levels[level * containerLevelSize];
+	int w = Reader::readS32LE(&selected[0]);
+	int h = Reader::readS32LE(&selected[4]);
+	uploadLevel(&data[Reader::readS32LE(&selected[8])], w, h);
+}
+
+// The pixels are only staged in atlas when glyphs are waiting to be baked into it, otherwise it is freed
+void Kravur::uploadLevel(const u8* pixels, int w, int h) {
 	texture = new Graphics4::Texture(w, h, Graphics4::Image::Grey8, true);
+	upload(pixels);
+	if (unbaked == 0) std::vector<u8>().swap(atlas);
+	else if (pixels != atlas.data()) atlas.assign(pixels, pixels + w * h);
+	shelfY = h;
+}
+
+void Kravur::upload(const u8* pixels) {
 	u8* bytes = texture->lock();
-	reader->read(bytes, w * h);
+	int stride = texture->stride();
+	for (int y = 0; y < texture->height; ++y) memcpy(&bytes[y * stride], &pixels[y * texture->width], texture->width);
 	texture->unlock();
-	reader->seek(0);
 }
 
+void Kravur::addGlyph(int codepoint, const BakedChar& glyph) {
+	int index = static_cast<int>(chars.size());
+	chars.push_back(glyph);
+	PendingGlyph none;
+	none.width = none.height = 0;
+	none.offset = -1;
+	pending.push_back(none);
+	if (codepoint >= 0 && codepoint < 256) {
+		latinGlyphs[codepoint] = index;
+		if (codepoint >= 32) latinAdvances[codepoint] = glyph.xadvance;
+	}
+	else glyphs[codepoint] = index;
+}
+
+int Kravur::decodeUtf8(const char* text, int length, int& index) {
+	const u8* bytes = reinterpret_cast<const u8*>(text);
+	u8 first = bytes[index];
+	int count = first >= 0xf8 ? 0 : first >= 0xf0 ? 3 : first >= 0xe0 ? 2 : first >= 0xc0 ? 1 : 0;
+	if (count > 0 && index + count < length) {
+		int codepoint = first & (0x3f >> count);
+		int i = 1;
+		for (; i <= count && (bytes[index + i] & 0xc0) == 0x80; ++i) {
+			codepoint = (codepoint << 6) | (bytes[index + i] & 0x3f);
+		}
+		if (i > count) {
+			index += count + 1;
+			return codepoint;
+		}
+	}
+	++index;
+	return first;
+}
+
+int Kravur::glyphIndex(int codepoint) {
+	if (codepoint >= 0 && codepoint < 256) return latinGlyphs[codepoint];
+	std::unordered_map<int, int>::iterator it = glyphs.find(codepoint);
+	return it == glyphs.end() ? -1 : it->second;
+}
+
+bool Kravur::needsBaking(int glyph) {
+	return glyph >= 0 && pending[glyph].offset >= 0;
+}
+
+// Glyphs are stored at the size of the largest level, for a smaller level they are box filtered down to it
+// and their boxes are kept in pixels of the largest level like the others.
+void Kravur::bakeGlyph(int glyph) {
+	PendingGlyph& source = pending[glyph];
+	if (source.offset < 0) return;
+	int offset = source.offset;
+	source.offset = -1;
+	--unbaked;
+
+	int scale = Kore::max(1, width / texture->width);
+	int w = (source.width + scale - 1) / scale;
+	int h = (source.height + scale - 1) / scale;
+	if (shelfX + w > texture->width) {
+		shelfX = 0;
+		shelfY += shelfHeight;
+		shelfHeight = 0;
+	}
+	if ((shelfY + h > texture->height && !growTexture(shelfY + h)) || w > texture->width) {
+		return; // does not fit, the glyph stays invisible
+	}
+
+	int stride = texture->width;
+	for (int y = 0; y < h; ++y) {
+		for (int x = 0; x < w; ++x) {
+			int sum = 0;
+			int count = 0;
+			for (int sy = y * scale; sy < Kore::min((y + 1) * scale, source.height); ++sy) {
+				for (int sx = x * scale; sx < Kore::min((x + 1) * scale, source.width); ++sx) {
+					sum += pendingPixels[offset + sy * source.width + sx];
+					++count;
+				}
+			}
+			atlas[(shelfY + y) * stride + shelfX + x] = static_cast<u8>((sum + count / 2) / count);
+		}
+	}
+	dirty = true;
+	++generation;
+
+	BakedChar& c = chars[glyph];
+	c.x0 = shelfX * scale;
+	c.y0 = shelfY * scale;
+	c.x1 = c.x0 + source.width;
+	c.y1 = c.y0 + source.height;
+	shelfX += w + 1;
+	shelfHeight = Kore::max(shelfHeight, h + 1);
+}
+
+// minHeight is in texture pixels. The atlas keeps its width so the new rows are simply appended,
+// the texture is uploaded by the next getTexture.
+bool Kravur::growTexture(int minHeight) {
+	int scale = Kore::max(1, width / texture->width);
+	int newHeight = texture->height;
+	while (newHeight < minHeight) newHeight *= 2;
+	if (newHeight > maxTextureSize) return false;
+
+	int textureWidth = texture->width;
+	atlas.resize(textureWidth * newHeight, 0);
+	delete texture;
+	texture = new Graphics4::Texture(textureWidth, newHeight, Graphics4::Image::Grey8, true);
+	height = newHeight * scale;
+	dirty = true;
+	++generation;
+	return true;
+}
+
+// Every glyph baked since the last call is uploaded with a single lock, once all are baked the copies are freed
 Graphics4::Texture* Kravur::getTexture() {
+	if (dirty) {
+		upload(atlas.data());
+		dirty = false;
+	}
+	if (unbaked == 0 && !atlas.empty()) {
+		std::vector<u8>().swap(atlas);
+		std::vector<u8>().swap(pendingPixels);
+	}
 	return texture;
 }
 
-AlignedQuad Kravur::getBakedQuad(int char_index, float xpos, float ypos) {
+AlignedQuad Kravur::getBakedQuad(int char_index, float xpos, float ypos, float scale) {
 	if (char_index >= static_cast<int>(chars.size())) return AlignedQuad();
 	float ipw = 1.0f / width;
 	float iph = 1.0f / height;
 	BakedChar b = chars[char_index];
 	if (b.x0 < 0) return AlignedQuad();
-	int round_x = static_cast<int>(Kore::round(xpos + b.xoff));
-	int round_y = static_cast<int>(Kore::round(ypos + b.yoff));
 
 	AlignedQuad q;
-	q.x0 = static_cast<float>(round_x);
-	q.y0 = static_cast<float>(round_y);
-	q.x1 = static_cast<float>(round_x + b.x1 - b.x0);
-	q.y1 = static_cast<float>(round_y + b.y1 - b.y0);
+	if (sdf) {
+		// distance fields are filtered, snapping to pixels is not needed
+		q.x0 = xpos + b.xoff * scale;
+		q.y0 = ypos + b.yoff * scale;
+		q.x1 = q.x0 + (b.x1 - b.x0) * scale;
+		q.y1 = q.y0 + (b.y1 - b.y0) * scale;
+	}
+	else {
+		int round_x = static_cast<int>(Kore::round(xpos + b.xoff));
+		int round_y = static_cast<int>(Kore::round(ypos + b.yoff));
+		q.x0 = static_cast<float>(round_x);
+		q.y0 = static_cast<float>(round_y);
+		q.x1 = static_cast<float>(round_x + b.x1 - b.x0);
+		q.y1 = static_cast<float>(round_y + b.y1 - b.y0);
+	}
 
 	q.s0 = b.x0 * ipw;
 	q.t0 = b.y0 * iph;
 	q.s1 = b.x1 * ipw;
 	q.t1 = b.y1 * iph;
 
-	q.xadvance = b.xadvance;
+	q.xadvance = b.xadvance * scale;
 
 	return q;
 }
 
+bool Kravur::isSdf() const {
+	return sdf;
+}
+
+float Kravur::getSdfRange() const {
+	return sdfRange;
+}
+
+u32 Kravur::getGeneration() const {
+	return generation;
+}
+
+float Kravur::getScale(float fontSize) const {
+	return sdf && size > 0 && fontSize > 0 ? fontSize / size : 1.0f;
+}
+
 float Kravur::getCharWidth(int charIndex) {
 	if (charIndex < 32) return 0;
-	if (charIndex - 32 >= static_cast<int>(chars.size())) return 0;
-	return chars[charIndex - 32].xadvance;
+	int glyph = glyphIndex(charIndex);
+	if (glyph < 0) return 0;
+	return chars[glyph].xadvance;
 }
 
-float Kravur::getHeight() {
-	return size;
+float Kravur::getHeight(float fontSize) {
+	return size * getScale(fontSize);
 }
 
 float Kravur::charWidth(char ch) {
-	return getCharWidth(ch);
+	return getCharWidth(static_cast<u8>(ch));
 }
 
-float Kravur::charsWidth(const char* ch, int offset, int length) {
-	return stringWidth(&ch[offset], length);
+float Kravur::charsWidth(const char* ch, int offset, int length, float fontSize) {
+	return stringWidth(&ch[offset], length, fontSize);
 }
 
-float Kravur::stringWidth(const char* string, int length) {
+// ASCII is summed four characters at a time straight from the advance table,
+// everything else goes through the UTF-8 decoder.
+float Kravur::stringWidth(const char* string, int length, float fontSize) {
+	if (length < 0) length = (int)strlen(string);
+	const u8* bytes = reinterpret_cast<const u8*>(string);
+	float32x4 sum = loadAll(0.0f);
 	float width = 0;
+	int c = 0;
+	while (c < length) {
+		if (c + 4 <= length && ((bytes[c] | bytes[c + 1] | bytes[c + 2] | bytes[c + 3]) & 0x80) == 0) {
+			sum = add(sum, Kore::load(latinAdvances[bytes[c]], latinAdvances[bytes[c + 1]], latinAdvances[bytes[c + 2]], latinAdvances[bytes[c + 3]]));
+			c += 4;
+		}
+		else if (bytes[c] < 0x80) {
+			width += latinAdvances[bytes[c]];
+			++c;
+		}
+		else {
+			width += getCharWidth(decodeUtf8(string, length, c));
+		}
+	}
+	return (width + get(sum, 0) + get(sum, 1) + get(sum, 2) + get(sum, 3)) * getScale(fontSize);
+}
+
+void Kravur::stringWidths(const char* const* strings, const int* lengths, int count, float* widths, float fontSize) {
+	for (int i = 0; i < count; ++i) {
+		widths[i] = stringWidth(strings[i], lengths != nullptr ? lengths[i] : -1, fontSize);
+	}
+}
+
+int Kravur::prefixWidths(const char* string, int length, float* widths, int* offsets, float fontSize) {
 	if (length < 0) length = (int)strlen(string);
-	for (int c = 0; c < length; ++c) {
-		width += getCharWidth(string[c]);
+	const u8* bytes = reinterpret_cast<const u8*>(string);
+	float scale = getScale(fontSize);
+	float width = 0;
+	int count = 0;
+	for (int c = 0; c < length; ++count) {
+		if (offsets != nullptr) offsets[count] = c;
+		if (bytes[c] < 0x80) {
+			width += latinAdvances[bytes[c]];
+			++c;
+		}
+		else {
+			width += getCharWidth(decodeUtf8(string, length, c));
+		}
+		widths[count] = width * scale;
 	}
-	return width;
+	return count;
 }
 
-float Kravur::getBaselinePosition() {
-	return baseline;
+float Kravur::getBaselinePosition(float fontSize) {
+	return baseline * getScale(fontSize);
 }
 
 #endif
@@ -2,6 +2,7 @@
 
 #include <Kore/Graphics4/Graphics.h>
 #include <Kore/IO/Reader.h>
+#include <unordered_map>
 #include <vector>
 
 struct FontStyle {
@@ -52,31 +53,91 @@ struct AlignedQuad {
 namespace Kore {
 	class Kravur {
 	private:
-		Kravur(Kore::Reader* reader);
+		Kravur(Kore::Reader* reader, bool sdf = false);
+
+		// A glyph which is stored in the font file but not yet copied into the texture
+		struct PendingGlyph {
+			int width;
+			int height;
+			int offset; // in pendingPixels, -1 when there is nothing left to bake
+		};
 
 		const char* name;
 		FontStyle style;
 		float size;
 
 		float mySize;
+		bool sdf;
+		float sdfRange;
 		std::vector<BakedChar> chars;
 		Graphics4::Texture* texture;
 		float baseline;
 		float getCharWidth(int charIndex);
 		float charWidth(char ch);
 
+		// codepoint to index in chars, a table for Latin-1 and a hash map for everything else
+		int latinGlyphs[256];
+		// advance of every Latin-1 character, 0 for control characters and missing glyphs
+		float latinAdvances[256];
+		std::unordered_map<int, int> glyphs;
+
+		std::vector<PendingGlyph> pending;
+		std::vector<u8> pendingPixels;
+		int unbaked; // pending glyphs which were neither baked nor dropped
+		// in texture pixels
+		int shelfX;
+		int shelfY;
+		int shelfHeight;
+		// Grey8 copy of the texture which glyphs are baked into and uploaded from by getTexture,
+		// it is only kept while there are unbaked glyphs
+		std::vector<u8> atlas;
+		bool dirty;
+		u32 generation;
+
+		void readContainer(Kore::Reader* reader);
+		void uploadLevel(const u8* pixels, int width, int height);
+		void addGlyph(int codepoint, const BakedChar& glyph);
+		bool growTexture(int minHeight);
+		void upload(const u8* pixels);
+
 	public:
+		// Size of the largest atlas level, glyph boxes are given in its pixels even when a smaller level is loaded
 		int width;
 		int height;
 
 		static Kravur* load(const char* name, FontStyle style, float size);
+		// Loads a signed distance field font which renders at every size, see getScale
+		static Kravur* loadSdf(const char* name, FontStyle style);
 
-		Graphics4::Texture* getTexture();
-		AlignedQuad getBakedQuad(int char_index, float xpos, float ypos);
+		// Decodes the UTF-8 character at index and advances index, bytes which are not valid UTF-8 are read as Latin-1
+		static int decodeUtf8(const char* text, int length, int& index);
 
-		float getHeight();
-		float charsWidth(const char* ch, int offset, int length);
-		float stringWidth(const char* string, int length = -1);
-		float getBaselinePosition();
+		Graphics4::Texture* getTexture();
+		// Changes whenever a glyph is baked or the texture grows, quads from an older generation can be stale
+		u32 getGeneration() const;
+		AlignedQuad getBakedQuad(int char_index, float xpos, float ypos, float scale = 1.0f);
+
+		bool isSdf() const;
+		// Distance in pixels of the largest atlas level which the field covers on each side of a glyph's edge
+		float getSdfRange() const;
+		// Factor from the size the font was baked at to fontSize, always 1 for bitmap fonts and a fontSize of 0
+		float getScale(float fontSize) const;
+
+		// Returns the index for getBakedQuad or -1 when the font has no such glyph
+		int glyphIndex(int codepoint);
+		bool needsBaking(int glyph);
+		// Copies a glyph into the atlas, this can replace the texture so pending draws using it have to be flushed first
+		void bakeGlyph(int glyph);
+
+		// The measurements are scaled to fontSize like drawn strings, 0 measures at the size the font was baked at
+		float getHeight(float fontSize = 0);
+		float charsWidth(const char* ch, int offset, int length, float fontSize = 0);
+		float stringWidth(const char* string, int length = -1, float fontSize = 0);
+		// Measures count strings at once, a length of -1 means zero terminated
+		void stringWidths(const char* const* strings, const int* lengths, int count, float* widths, float fontSize = 0);
+		// Writes the width of the string up to and including each character to widths and, when offsets is given,
+		// the byte offset each character starts at. Both need room for length entries. Returns the number of characters.
+		int prefixWidths(const char* string, int length, float* widths, int* offsets = nullptr, float fontSize = 0);
+		float getBaselinePosition(float fontSize = 0);
 	};
 }
@@ -0,0 +1,130 @@
+#include "pch.h"
+
+#include "TextureAtlas.h"
+
+#include <Kore/Math/Core.h>
+
+#include <string.h>
+
+using namespace Kore;
+
+#ifdef KORE_G4
+
+Graphics2::TextureAtlas::TextureAtlas(int size, int maxImageSize, int padding)
+    : size(size), maxImageSize(maxImageSize), padding(padding), nextShelfY(0), dirty(true), dirtyLeft(0), dirtyTop(0), dirtyRight(size), dirtyBottom(size) {
+	texture = new Graphics4::Texture(size, size, Graphics4::Image::RGBA32, true);
+	pixels = new u8[size * size * 4];
+	memset(pixels, 0, size * size * 4);
+	stats.totalPixels = size * size;
+}
+
+Graphics2::TextureAtlas::~TextureAtlas() {
+	delete texture;
+	delete[] pixels;
+}
+
+Graphics4::Texture* Graphics2::TextureAtlas::getTexture() {
+	return texture;
+}
+
+const Graphics2::AtlasStats& Graphics2::TextureAtlas::getStats() const {
+	return stats;
+}
+
+void Graphics2::TextureAtlas::_countSavedBatch() {
+	++stats.batchesSaved;
+}
+
+bool Graphics2::TextureAtlas::lookup(Graphics4::Texture* image, int& x, int& y) {
+	std::map<u32, Region>::iterator it = regions.find(image->id);
+	if (it == regions.end()) {
+		Region region;
+		region.inAtlas = insert(image, region);
+		if (region.inAtlas) ++stats.images;
+		else ++stats.rejectedImages;
+		it = regions.insert(std::make_pair(image->id, region)).first;
+	}
+	x = it->second.x;
+	y = it->second.y;
+	return it->second.inAtlas;
+}
+
+// One lock per update. OpenGL locks the texture's own copy of its pixels, so only the dirty rectangle is copied there,
+// the other backends can discard the old contents on lock and get the complete atlas.
+void Graphics2::TextureAtlas::update() {
+	if (!dirty) return;
+#ifdef KORE_OPENGL
+	int left = dirtyLeft, top = dirtyTop, right = dirtyRight, bottom = dirtyBottom;
+#else
+	int left = 0, top = 0, right = size, bottom = size;
+#endif
+	u8* to = texture->lock();
+	int stride = texture->stride();
+	for (int y = top; y < bottom; ++y) memcpy(&to[y * stride + left * 4], &pixels[(y * size + left) * 4], (right - left) * 4);
+	texture->unlock(dirtyLeft, dirtyTop, dirtyRight - dirtyLeft, dirtyBottom - dirtyTop);
+	dirty = false;
+}
+
+bool Graphics2::TextureAtlas::insert(Graphics4::Texture* image, Region& region) {
+	region.x = region.y = 0;
+	if (image->data == nullptr || image->format != Graphics4::Image::RGBA32 || image->compression != Graphics1::ImageCompressionNone) return false;
+	if (image->width > maxImageSize || image->height > maxImageSize) return false;
+
+	int width = image->width + padding * 2;
+	int height = image->height + padding * 2;
+
+	// best fitting shelf, a new shelf is only opened when no existing one has room
+	Shelf* best = nullptr;
+	for (unsigned i = 0; i < shelves.size(); ++i) {
+		Shelf& shelf = shelves[i];
+		if (height <= shelf.height && shelf.width + width <= size && (best == nullptr || shelf.height < best->height)) best = &shelf;
+	}
+	if (best == nullptr) {
+		if (nextShelfY + height > size || width > size) return false;
+		Shelf shelf;
+		shelf.y = nextShelfY;
+		shelf.height = height;
+		shelf.width = 0;
+		shelves.push_back(shelf);
+		nextShelfY += height;
+		best = &shelves.back();
+	}
+
+	copy(image, best->width, best->y);
+	region.x = best->width + padding;
+	region.y = best->y + padding;
+	best->width += width;
+	stats.usedPixels += width * height;
+	if (dirty) {
+		dirtyLeft = Kore::min(dirtyLeft, best->width - width);
+		dirtyTop = Kore::min(dirtyTop, best->y);
+		dirtyRight = Kore::max(dirtyRight, best->width);
+		dirtyBottom = Kore::max(dirtyBottom, best->y + height);
+	}
+	else {
+		dirtyLeft = best->width - width;
+		dirtyTop = best->y;
+		dirtyRight = best->width;
+		dirtyBottom = best->y + height;
+	}
+	dirty = true;
+	return true;
+}
+
+void Graphics2::TextureAtlas::copy(Graphics4::Texture* image, int x, int y) {
+	u8* to = pixels;
+	int toStride = size * 4;
+	int fromStride = image->width * 4;
+	// the border is filled with the image's edge pixels so bilinear filtering does not bleed in neighbours
+	for (int row = -padding; row < image->height + padding; ++row) {
+		u8* from = &image->data[Kore::clamp(row, 0, image->height - 1) * fromStride];
+		u8* line = &to[(y + padding + row) * toStride + x * 4];
+		for (int column = 0; column < padding; ++column) {
+			memcpy(&line[column * 4], from, 4);
+			memcpy(&line[(padding + image->width + column) * 4], &from[fromStride - 4], 4);
+		}
+		memcpy(&line[padding * 4], from, fromStride);
+	}
+}
+
+#endif
@@ -0,0 +1,70 @@
+#pragma once
+
+#include <Kore/Graphics4/Graphics.h>
+
+#include <map>
+#include <vector>
+
+namespace Kore {
+	namespace Graphics2 {
+		struct AtlasStats {
+			AtlasStats() : images(0), rejectedImages(0), usedPixels(0), totalPixels(0), batchesSaved(0) {}
+
+			int images;         // images which have been copied into the atlas
+			int rejectedImages; // images which are too big, not readable or did not fit anymore
+			int usedPixels;     // including padding
+			int totalPixels;
+			int batchesSaved; // texture switches which did not have to flush because both images live in the atlas
+
+			float occupancy() const {
+				return totalPixels > 0 ? usedPixels / (float)totalPixels : 0.0f;
+			}
+		};
+
+		// Packs small readable RGBA32 textures into one big texture so that
+		// Graphics2 can batch them together. Images are added on first use and
+		// stay in the atlas until it is destroyed.
+		class TextureAtlas {
+		public:
+			TextureAtlas(int size = 2048, int maxImageSize = 256, int padding = 1);
+			~TextureAtlas();
+
+			// Returns false when the image is not part of the atlas and has to be drawn on its own
+			bool lookup(Graphics4::Texture* image, int& x, int& y);
+			Graphics4::Texture* getTexture();
+			// Uploads images which were added since the last update
+			void update();
+
+			const AtlasStats& getStats() const;
+			void _countSavedBatch(); // Do not call this directly, used by Graphics2
+
+		private:
+			struct Region {
+				bool inAtlas;
+				int x;
+				int y;
+			};
+
+			struct Shelf {
+				int y;
+				int height;
+				int width;
+			};
+
+			bool insert(Graphics4::Texture* image, Region& region);
+			void copy(Graphics4::Texture* image, int x, int y);
+
+			Graphics4::Texture* texture;
+			u8* pixels; // the whole atlas is kept in memory, lock does not preserve contents on every backend
+			int size;
+			int maxImageSize;
+			int padding;
+			int nextShelfY;
+			bool dirty;
+			int dirtyLeft, dirtyTop, dirtyRight, dirtyBottom;
+			std::vector<Shelf> shelves;
+			std::map<u32, Region> regions;
+			AtlasStats stats;
+		};
+	}
+}
@@ -22,6 +22,7 @@ namespace Kore {
 			float* lock();
 			float* lock(int start, int count);
 			void unlock();
+			void unlock(int count); // only uploads the first count vertices of the locked range
 			int count();
 			int stride();
 			int _set(int offset = 0); // Do not call this directly, use Graphics::setVertexBuffers
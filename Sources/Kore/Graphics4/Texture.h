@@ -33,6 +33,8 @@ namespace Kore {
 			void _setImage(TextureUnit unit);
 			u8* lock();
 			void unlock();
+			// Ends a lock like unlock but only the given region of the locked data has to be uploaded, which can be empty
+			void unlock(int x, int y, int width, int height);
 			void clear(int x, int y, int z, int width, int height, int depth, uint color);
 #if defined(KORE_IOS) || defined(KORE_MACOS)
 			void upload(u8* data, int stride);
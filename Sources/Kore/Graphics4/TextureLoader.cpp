@@ -0,0 +1,56 @@
+#include "pch.h"
+
+#include "TextureLoader.h"
+
+using namespace Kore;
+
+#ifdef KORE_G4
+
+Graphics4::TextureLoader::TextureLoader() {}
+
+void Graphics4::TextureLoader::load(const char* filename, bool readable, Callback callback, void* data) {
+	load(&filename, 1, readable, callback, data);
+}
+
+void Graphics4::TextureLoader::load(const char* const* filenames, int count, bool readable, Callback callback, void* data) {
+	for (int i = 0; i < count; ++i) {
+		Request* request = new Request;
+		request->loader = this;
+		request->readable = readable;
+		request->callback = callback;
+		request->data = data;
+		// images are always decoded readable so that their pixels survive until the upload
+		images.load(filenames[i], true, upload, request);
+	}
+}
+
+void Graphics4::TextureLoader::update(int max) {
+	images.update(max);
+}
+
+int Graphics4::TextureLoader::pending() {
+	return images.pending();
+}
+
+void Graphics4::TextureLoader::finish() {
+	images.finish();
+}
+
+// The texture takes over the decoded pixels
+void Graphics4::TextureLoader::upload(const char* filename, Graphics1::Image* image, void* param) {
+	Request* request = static_cast<Request*>(param);
+	Texture* texture;
+	if (image->compression != Graphics1::ImageCompressionNone || image->getPixels() == nullptr) {
+		texture = new Texture(filename, request->readable);
+	}
+	else {
+		texture = new Texture(image->getPixels(), image->width, image->height, image->format, request->readable);
+		image->data = nullptr;
+		image->hdrData = nullptr;
+	}
+	delete image;
+	request->callback(filename, texture, request->data);
+	delete request;
+}
+
+#endif
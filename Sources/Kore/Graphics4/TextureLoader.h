@@ -0,0 +1,36 @@
+#pragma once
+
+#include <Kore/Graphics1/ImageLoader.h>
+#include <Kore/Graphics4/Texture.h>
+
+namespace Kore {
+	namespace Graphics4 {
+		// Decodes images with a Graphics1::ImageLoader and creates the textures
+		// in update, which has to be called on the thread owning the graphics context.
+		class TextureLoader {
+		public:
+			typedef void (*Callback)(const char* filename, Texture* texture, void* data);
+
+			TextureLoader();
+
+			void load(const char* filename, bool readable, Callback callback, void* data = nullptr);
+			void load(const char* const* filenames, int count, bool readable, Callback callback, void* data = nullptr);
+			// Uploads at most max textures so a loading screen can keep its frame rate, a negative max uploads all finished images
+			void update(int max = -1);
+			int pending();
+			void finish();
+
+		private:
+			struct Request {
+				TextureLoader* loader;
+				bool readable;
+				Callback callback;
+				void* data;
+			};
+
+			static void upload(const char* filename, Graphics1::Image* image, void* request);
+
+			Graphics1::ImageLoader images;
+		};
+	}
+}
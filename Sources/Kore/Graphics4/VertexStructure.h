@@ -11,7 +11,8 @@ namespace Kore {
 			Float4x4VertexData, // not supported in fixed function OpenGL
 			Short2NormVertexData,
 			Short4NormVertexData,
-			ColorVertexData
+			ColorVertexData,
+			Byte4NormVertexData // four unsigned bytes in memory order, normalized to 0..1
 		};
 
 		enum Usage {
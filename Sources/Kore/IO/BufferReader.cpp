@@ -29,6 +29,10 @@ namespace Kore {
 		return readAllBuffer;
 	}
 
+	const void* BufferReader::map() {
+		return buffer;
+	}
+
 	int BufferReader::size() const {
 		return bufferSize;
 	}
@@ -15,6 +15,7 @@ namespace Kore {
 		virtual ~BufferReader();
 		int read(void* data, int size) override;
 		void* readAll() override;
+		const void* map() override;
 		int size() const override;
 		int pos() const override;
 		void seek(int pos) override;
@@ -39,6 +39,7 @@ namespace Kore {
 		void close();
 		int read(void* data, int size) override;
 		void* readAll() override;
+		const void* map() override;
 		int size() const override;
 		int pos() const override;
 		void seek(int pos) override;
@@ -46,6 +47,8 @@ namespace Kore {
 		FileReaderData data;
 		FileType type;
 		void* readdata;
+		const void* mapped;
+		void* mapping;
 	};
 
 	void setFilesLocation(char* dir);
@@ -46,6 +46,14 @@ const char* macgetresourcepath();
 #define KORE_LINUX
 #endif
 
+#ifdef KORE_WINDOWS
+#include <io.h>
+#endif
+
+#if defined(KORE_LINUX) || defined(KORE_MACOS) || defined(KORE_IOS) || defined(KORE_ANDROID)
+#include <sys/mman.h>
+#endif
+
 using namespace Kore;
 
 namespace {
@@ -72,7 +80,7 @@ void initAndroidFileReader() {
 }
 #endif
 
-FileReader::FileReader() : readdata(nullptr) {
+FileReader::FileReader() : readdata(nullptr), mapped(nullptr), mapping(nullptr) {
 #ifdef KORE_ANDROID
 	data.size = 0;
 	data.pos = 0;
@@ -84,7 +92,7 @@ FileReader::FileReader() : readdata(nullptr) {
 #endif
 }
 
-FileReader::FileReader(const char* filename, FileType type) : readdata(nullptr) {
+FileReader::FileReader(const char* filename, FileType type) : readdata(nullptr), mapped(nullptr), mapping(nullptr) {
 #ifdef KORE_ANDROID
 	data.size = 0;
 	data.pos = 0;
@@ -250,6 +258,40 @@ void* FileReader::readAll() {
 	return readdata;
 }
 
+// Maps the file where the platform allows it, everything else falls back to readAll
+const void* FileReader::map() {
+	if (mapped != nullptr) return mapped;
+	if (data.size == 0) return readAll();
+#ifdef KORE_ANDROID
+	if (data.file == nullptr) {
+		// uncompressed assets are handed out straight from the apk
+		mapped = AAsset_getBuffer(data.asset);
+		if (mapped != nullptr) return mapped;
+		return readAll();
+	}
+#endif
+#if defined(KORE_LINUX) || defined(KORE_MACOS) || defined(KORE_IOS) || defined(KORE_ANDROID)
+	void* address = mmap(nullptr, data.size, PROT_READ, MAP_PRIVATE, fileno((FILE*)data.file), 0);
+	if (address != MAP_FAILED) {
+		mapped = address;
+		mapping = address;
+		return mapped;
+	}
+#elif defined(KORE_WINDOWS)
+	HANDLE handle = (HANDLE)_get_osfhandle(_fileno((FILE*)data.file));
+	HANDLE fileMapping = CreateFileMappingA(handle, nullptr, PAGE_READONLY, 0, 0, nullptr);
+	if (fileMapping != nullptr) {
+		mapped = MapViewOfFile(fileMapping, FILE_MAP_READ, 0, 0, 0);
+		if (mapped != nullptr) {
+			mapping = fileMapping;
+			return mapped;
+		}
+		CloseHandle(fileMapping);
+	}
+#endif
+	return readAll();
+}
+
 void FileReader::seek(int pos) {
 #ifdef KORE_ANDROID
 	if (data.file != nullptr) {
@@ -265,6 +307,16 @@ void FileReader::seek(int pos) {
 }
 
 void FileReader::close() {
+	if (mapping != nullptr) {
+#if defined(KORE_LINUX) || defined(KORE_MACOS) || defined(KORE_IOS) || defined(KORE_ANDROID)
+		munmap(mapping, data.size);
+#elif defined(KORE_WINDOWS)
+		UnmapViewOfFile(mapped);
+		CloseHandle(mapping);
+#endif
+		mapping = nullptr;
+	}
+	mapped = nullptr;
 #ifdef KORE_ANDROID
 	if (data.file != nullptr) {
 		fclose(data.file);
@@ -6,6 +6,11 @@ namespace Kore {
 		virtual ~Reader() {}
 		virtual int read(void* data, int size) = 0;
 		virtual void* readAll() = 0;
+		// Like readAll but without a private copy where the reader can avoid one,
+		// the contents stay valid until the reader is closed and must not be written to
+		virtual const void* map() {
+			return readAll();
+		}
 		virtual int size() const = 0;
 		virtual int pos() const = 0;
 		virtual void seek(int pos) = 0;
@@ -11,6 +11,10 @@ namespace Kore {
 		return _mm_set_ps(d, c, b, a);
 	}
 
+	inline float32x4 load(const float* source) {
+		return _mm_loadu_ps(source);
+	}
+
 	inline float32x4 loadAll(float t) {
 		return _mm_set_ps1(t);
 	}
@@ -24,6 +28,10 @@ namespace Kore {
 		return converter.elements[index];
 	}
 
+	inline void store(float* destination, float32x4 t) {
+		_mm_storeu_ps(destination, t);
+	}
+
 	inline float32x4 abs(float32x4 t) {
 		__m128 mask = _mm_set_ps1(-0.f);
 		return _mm_andnot_ps(mask, t);
@@ -37,6 +45,14 @@ namespace Kore {
 		return _mm_div_ps(a, b);
 	}
 
+	inline float32x4 max(float32x4 a, float32x4 b) {
+		return _mm_max_ps(a, b);
+	}
+
+	inline float32x4 min(float32x4 a, float32x4 b) {
+		return _mm_min_ps(a, b);
+	}
+
 	inline float32x4 mul(float32x4 a, float32x4 b) {
 		return _mm_mul_ps(a, b);
 	}
@@ -74,6 +90,10 @@ namespace Kore {
 		return {a, b, c, d};
 	}
 
+	inline float32x4 load(const float* source) {
+		return vld1q_f32(source);
+	}
+
 	inline float32x4 loadAll(float t) {
 		return {t, t, t, t};
 	}
@@ -82,6 +102,10 @@ namespace Kore {
 		return t[index];
 	}
 
+	inline void store(float* destination, float32x4 t) {
+		vst1q_f32(destination, t);
+	}
+
 	inline float32x4 abs(float32x4 t) {
 		return vabsq_f32(t);
 	}
@@ -101,6 +125,14 @@ namespace Kore {
 #endif
 	}
 
+	inline float32x4 max(float32x4 a, float32x4 b) {
+		return vmaxq_f32(a, b);
+	}
+
+	inline float32x4 min(float32x4 a, float32x4 b) {
+		return vminq_f32(a, b);
+	}
+
 	inline float32x4 mul(float32x4 a, float32x4 b) {
 		return vmulq_f32(a, b);
 	}
@@ -148,6 +180,15 @@ namespace Kore {
 		return value;
 	}
 
+	inline float32x4 load(const float* source) {
+		float32x4 value;
+		value.values[0] = source[0];
+		value.values[1] = source[1];
+		value.values[2] = source[2];
+		value.values[3] = source[3];
+		return value;
+	}
+
 	inline float32x4 loadAll(float t) {
 		float32x4 value;
 		value.values[0] = t;
@@ -161,6 +202,13 @@ namespace Kore {
 		return t.values[index];
 	}
 
+	inline void store(float* destination, float32x4 t) {
+		destination[0] = t.values[0];
+		destination[1] = t.values[1];
+		destination[2] = t.values[2];
+		destination[3] = t.values[3];
+	}
+
 	inline float32x4 abs(float32x4 t) {
 		float32x4 value;
 		value.values[0] = Kore::abs(t.values[0]);
@@ -188,6 +236,24 @@ namespace Kore {
 		return value;
 	}
 
+	inline float32x4 max(float32x4 a, float32x4 b) {
+		float32x4 value;
+		value.values[0] = Kore::max(a.values[0], b.values[0]);
+		value.values[1] = Kore::max(a.values[1], b.values[1]);
+		value.values[2] = Kore::max(a.values[2], b.values[2]);
+		value.values[3] = Kore::max(a.values[3], b.values[3]);
+		return value;
+	}
+
+	inline float32x4 min(float32x4 a, float32x4 b) {
+		float32x4 value;
+		value.values[0] = Kore::min(a.values[0], b.values[0]);
+		value.values[1] = Kore::min(a.values[1], b.values[1]);
+		value.values[2] = Kore::min(a.values[2], b.values[2]);
+		value.values[3] = Kore::min(a.values[3], b.values[3]);
+		return value;
+	}
+
 	inline float32x4 mul(float32x4 a, float32x4 b) {
 		float32x4 value;
 		value.values[0] = a.values[0] * b.values[0];
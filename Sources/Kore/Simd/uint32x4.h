@@ -0,0 +1,219 @@
+#pragma once
+
+#if defined(__SSE2__) || _M_IX86_FP == 2 || defined(_M_X64)
+
+#include <emmintrin.h>
+
+namespace Kore {
+	typedef __m128i uint32x4;
+
+	inline uint32x4 load(const u32* source) {
+		return _mm_loadu_si128((const __m128i*)source);
+	}
+
+	inline uint32x4 loadAll(u32 t) {
+		return _mm_set1_epi32((int)t);
+	}
+
+	inline void store(u32* destination, uint32x4 t) {
+		_mm_storeu_si128((__m128i*)destination, t);
+	}
+
+	inline uint32x4 bitAnd(uint32x4 a, uint32x4 b) {
+		return _mm_and_si128(a, b);
+	}
+
+	inline uint32x4 bitOr(uint32x4 a, uint32x4 b) {
+		return _mm_or_si128(a, b);
+	}
+
+	inline uint32x4 shiftLeft(uint32x4 t, int bits) {
+		return _mm_slli_epi32(t, bits);
+	}
+
+	inline uint32x4 shiftRight(uint32x4 t, int bits) {
+		return _mm_srli_epi32(t, bits);
+	}
+
+	// Per byte a + (b - a) * t / 255
+	inline uint32x4 lerpBytes(uint32x4 a, uint32x4 b, uint32x4 t) {
+		__m128i zero = _mm_setzero_si128();
+		__m128i max = _mm_set1_epi16(255);
+		__m128i half = _mm_set1_epi16(128);
+
+		__m128i tLow = _mm_unpacklo_epi8(t, zero);
+		__m128i low = _mm_add_epi16(_mm_mullo_epi16(_mm_unpacklo_epi8(a, zero), _mm_sub_epi16(max, tLow)), _mm_mullo_epi16(_mm_unpacklo_epi8(b, zero), tLow));
+		low = _mm_add_epi16(low, half);
+		low = _mm_srli_epi16(_mm_add_epi16(low, _mm_srli_epi16(low, 8)), 8);
+
+		__m128i tHigh = _mm_unpackhi_epi8(t, zero);
+		__m128i high = _mm_add_epi16(_mm_mullo_epi16(_mm_unpackhi_epi8(a, zero), _mm_sub_epi16(max, tHigh)), _mm_mullo_epi16(_mm_unpackhi_epi8(b, zero), tHigh));
+		high = _mm_add_epi16(high, half);
+		high = _mm_srli_epi16(_mm_add_epi16(high, _mm_srli_epi16(high, 8)), 8);
+
+		return _mm_packus_epi16(low, high);
+	}
+
+	// Per byte a + b, saturated at 255
+	inline uint32x4 addBytes(uint32x4 a, uint32x4 b) {
+		return _mm_adds_epu8(a, b);
+	}
+}
+
+#elif defined(KORE_IOS) || defined(__ARM_NEON)
+
+#include <arm_neon.h>
+
+namespace Kore {
+	typedef uint32x4_t uint32x4;
+
+	inline uint32x4 load(const u32* source) {
+		return vld1q_u32(source);
+	}
+
+	inline uint32x4 loadAll(u32 t) {
+		return vdupq_n_u32(t);
+	}
+
+	inline void store(u32* destination, uint32x4 t) {
+		vst1q_u32(destination, t);
+	}
+
+	inline uint32x4 bitAnd(uint32x4 a, uint32x4 b) {
+		return vandq_u32(a, b);
+	}
+
+	inline uint32x4 bitOr(uint32x4 a, uint32x4 b) {
+		return vorrq_u32(a, b);
+	}
+
+	inline uint32x4 shiftLeft(uint32x4 t, int bits) {
+		return vshlq_u32(t, vdupq_n_s32(bits));
+	}
+
+	inline uint32x4 shiftRight(uint32x4 t, int bits) {
+		return vshlq_u32(t, vdupq_n_s32(-bits));
+	}
+
+	// Per byte a + (b - a) * t / 255
+	inline uint32x4 lerpBytes(uint32x4 a, uint32x4 b, uint32x4 t) {
+		uint8x16_t a8 = vreinterpretq_u8_u32(a);
+		uint8x16_t b8 = vreinterpretq_u8_u32(b);
+		uint8x16_t t8 = vreinterpretq_u8_u32(t);
+		uint8x16_t inverse = vsubq_u8(vdupq_n_u8(255), t8);
+
+		uint16x8_t low = vmlal_u8(vmull_u8(vget_low_u8(a8), vget_low_u8(inverse)), vget_low_u8(b8), vget_low_u8(t8));
+		uint16x8_t high = vmlal_u8(vmull_u8(vget_high_u8(a8), vget_high_u8(inverse)), vget_high_u8(b8), vget_high_u8(t8));
+
+		uint8x8_t lowResult = vrshrn_n_u16(vrsraq_n_u16(low, low, 8), 8);
+		uint8x8_t highResult = vrshrn_n_u16(vrsraq_n_u16(high, high, 8), 8);
+		return vreinterpretq_u32_u8(vcombine_u8(lowResult, highResult));
+	}
+
+	// Per byte a + b, saturated at 255
+	inline uint32x4 addBytes(uint32x4 a, uint32x4 b) {
+		return vreinterpretq_u32_u8(vqaddq_u8(vreinterpretq_u8_u32(a), vreinterpretq_u8_u32(b)));
+	}
+}
+
+#else
+
+namespace Kore {
+	struct uint32x4 {
+		u32 values[4];
+	};
+
+	inline uint32x4 load(const u32* source) {
+		uint32x4 value;
+		value.values[0] = source[0];
+		value.values[1] = source[1];
+		value.values[2] = source[2];
+		value.values[3] = source[3];
+		return value;
+	}
+
+	inline uint32x4 loadAll(u32 t) {
+		uint32x4 value;
+		value.values[0] = t;
+		value.values[1] = t;
+		value.values[2] = t;
+		value.values[3] = t;
+		return value;
+	}
+
+	inline void store(u32* destination, uint32x4 t) {
+		destination[0] = t.values[0];
+		destination[1] = t.values[1];
+		destination[2] = t.values[2];
+		destination[3] = t.values[3];
+	}
+
+	inline uint32x4 bitAnd(uint32x4 a, uint32x4 b) {
+		uint32x4 value;
+		value.values[0] = a.values[0] & b.values[0];
+		value.values[1] = a.values[1] & b.values[1];
+		value.values[2] = a.values[2] & b.values[2];
+		value.values[3] = a.values[3] & b.values[3];
+		return value;
+	}
+
+	inline uint32x4 bitOr(uint32x4 a, uint32x4 b) {
+		uint32x4 value;
+		value.values[0] = a.values[0] | b.values[0];
+		value.values[1] = a.values[1] | b.values[1];
+		value.values[2] = a.values[2] | b.values[2];
+		value.values[3] = a.values[3] | b.values[3];
+		return value;
+	}
+
+	inline uint32x4 shiftLeft(uint32x4 t, int bits) {
+		uint32x4 value;
+		value.values[0] = t.values[0] << bits;
+		value.values[1] = t.values[1] << bits;
+		value.values[2] = t.values[2] << bits;
+		value.values[3] = t.values[3] << bits;
+		return value;
+	}
+
+	inline uint32x4 shiftRight(uint32x4 t, int bits) {
+		uint32x4 value;
+		value.values[0] = t.values[0] >> bits;
+		value.values[1] = t.values[1] >> bits;
+		value.values[2] = t.values[2] >> bits;
+		value.values[3] = t.values[3] >> bits;
+		return value;
+	}
+
+	// Per byte a + (b - a) * t / 255
+	inline uint32x4 lerpBytes(uint32x4 a, uint32x4 b, uint32x4 t) {
+		uint32x4 value;
+		for (int i = 0; i < 4; ++i) {
+			u32 result = 0;
+			for (int shift = 0; shift < 32; shift += 8) {
+				u32 x = (a.values[i] >> shift) & 0xff;
+				u32 y = (b.values[i] >> shift) & 0xff;
+				u32 s = (t.values[i] >> shift) & 0xff;
+				u32 mixed = x * (255 - s) + y * s + 128;
+				result |= ((mixed + (mixed >> 8)) >> 8) << shift;
+			}
+			value.values[i] = result;
+		}
+		return value;
+	}
+
+	// Per byte a + b, saturated at 255
+	inline uint32x4 addBytes(uint32x4 a, uint32x4 b) {
+		uint32x4 value;
+		for (int i = 0; i < 4; ++i) {
+			u32 result = 0;
+			for (int shift = 0; shift < 32; shift += 8) {
+				u32 sum = ((a.values[i] >> shift) & 0xff) + ((b.values[i] >> shift) & 0xff);
+				result |= (sum > 255 ? 255 : sum) << shift;
+			}
+			value.values[i] = result;
+		}
+		return value;
+	}
+}
+
+#endif
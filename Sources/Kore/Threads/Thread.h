@@ -1,5 +1,10 @@
 #pragma once
 
+// Threads and semaphores are implemented by the POSIX and Microsoft backends, HTML5 has neither
+#if defined(KORE_POSIX) || defined(KORE_MICROSOFT)
+#define KORE_THREADS
+#endif
+
 namespace Kore {
 	const uint MAX_THREADS = 8;
 
@@ -10,6 +15,7 @@ namespace Kore {
 	void threadsInit();
 	void threadsQuit();
 
+	// Returns nullptr when all MAX_THREADS threads are taken
 	Thread* createAndRunThread(void (*thread)(void* param), void* param);
 	void waitForThreadStopThenFree(Thread* sr);
 	bool isThreadStoppedThenFree(Thread* sr);
@@ -0,0 +1,29 @@
+#version 450
+
+uniform sampler2D tex0;
+uniform sampler2D tex1;
+uniform sampler2D tex2;
+uniform sampler2D tex3;
+uniform sampler2D tex4;
+uniform sampler2D tex5;
+uniform sampler2D tex6;
+uniform sampler2D tex7;
+in vec2 texCoord;
+in vec4 color;
+in float index;
+out vec4 FragColor;
+
+void main() {
+	vec4 texcolor;
+	if (index < 0.5) texcolor = texture(tex0, texCoord);
+	else if (index < 1.5) texcolor = texture(tex1, texCoord);
+	else if (index < 2.5) texcolor = texture(tex2, texCoord);
+	else if (index < 3.5) texcolor = texture(tex3, texCoord);
+	else if (index < 4.5) texcolor = texture(tex4, texCoord);
+	else if (index < 5.5) texcolor = texture(tex5, texCoord);
+	else if (index < 6.5) texcolor = texture(tex6, texCoord);
+	else texcolor = texture(tex7, texCoord);
+	texcolor *= color;
+	texcolor.rgb *= color.a;
+	FragColor = texcolor;
+}
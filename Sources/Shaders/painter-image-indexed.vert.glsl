@@ -0,0 +1,17 @@
+#version 450
+
+in vec2 vertexPosition;
+in vec2 texPosition;
+in vec4 vertexColor;
+in float texIndex;
+uniform mat4 projectionMatrix;
+out vec2 texCoord;
+out vec4 color;
+out float index;
+
+void main() {
+	gl_Position = projectionMatrix * vec4(vertexPosition, -5.0, 1.0);
+	texCoord = texPosition;
+	color = vertexColor;
+	index = texIndex;
+}
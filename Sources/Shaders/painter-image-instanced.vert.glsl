@@ -0,0 +1,18 @@
+#version 450
+
+in vec2 vertexPosition;
+in vec2 spriteX;
+in vec2 spriteY;
+in vec2 spriteOrigin;
+in vec4 spriteSource;
+in vec4 spriteColor;
+uniform mat4 projectionMatrix;
+out vec2 texCoord;
+out vec4 color;
+
+void main() {
+	vec2 position = spriteOrigin + vertexPosition.x * spriteX + vertexPosition.y * spriteY;
+	gl_Position = projectionMatrix * vec4(position, -5.0, 1.0);
+	texCoord = mix(spriteSource.xy, spriteSource.zw, vertexPosition);
+	color = spriteColor;
+}
@@ -0,0 +1,22 @@
+#version 450
+
+uniform sampler2D tex;
+uniform vec2 sdfRange; // distance covered on each side of an edge, in texture coordinates
+in vec2 texCoord;
+in vec4 fragmentColor;
+out vec4 FragColor;
+
+void main() {
+	float distance = texture(tex, texCoord).r;
+	float alpha;
+	if (sdfRange.x > 0.0) {
+		// both sides of the field in screen pixels, which turns the distance into pixel coverage
+		float screenRange = max(dot(sdfRange, vec2(1.0) / fwidth(texCoord)), 1.0);
+		alpha = clamp((distance - 0.5) * screenRange + 0.5, 0.0, 1.0);
+	}
+	else {
+		float smoothing = fwidth(distance) * 0.5;
+		alpha = smoothstep(0.5 - smoothing, 0.5 + smoothing, distance);
+	}
+	FragColor = vec4(fragmentColor.rgb, alpha * fragmentColor.a);
+}
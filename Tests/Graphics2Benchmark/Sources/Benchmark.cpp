@@ -0,0 +1,103 @@
+#include "pch.h"
+
+#include <Kore/Graphics2/Graphics.h>
+#include <Kore/Graphics4/Graphics.h>
+#include <Kore/System.h>
+
+#include <stdio.h>
+#include <string.h>
+
+using namespace Kore;
+
+// Draws rotated sprites and rects through Graphics2 and prints how many the CPU side
+// submits per second, so the numbers can be compared between revisions.
+namespace {
+	const int spritesPerFrame = 20000;
+	const int width = 1024;
+	const int height = 768;
+
+	Graphics2::Graphics2* g2;
+	Graphics4::Texture* texture;
+	Graphics2::Sprite* sprites;
+
+	double imageTime = 0;
+	double rectTime = 0;
+	double spriteTime = 0;
+	int frames = 0;
+	double lastReport = 0;
+
+	float position(int index, int range) {
+		return static_cast<float>((index * 7919) % range);
+	}
+
+	void update() {
+		Graphics4::begin();
+		g2->begin();
+
+		g2->transformation = mat3::Translation(width / 2.0f, height / 2.0f) * mat3::RotationZ(0.1f) * mat3::Translation(-width / 2.0f, -height / 2.0f);
+
+		double start = System::time();
+		for (int i = 0; i < spritesPerFrame; ++i) {
+			g2->drawScaledSubImage(texture, 0, 0, 16, 16, position(i, width), position(i * 3, height), 16, 16);
+		}
+		g2->flush();
+		double afterImages = System::time();
+
+		for (int i = 0; i < spritesPerFrame; ++i) {
+			g2->fillRect(position(i, width), position(i * 3, height), 4, 4);
+		}
+		g2->flush();
+		double afterRects = System::time();
+
+		g2->drawSprites(texture, sprites, spritesPerFrame);
+		g2->flush();
+		double afterSprites = System::time();
+
+		g2->transformation = mat3::Identity();
+		g2->end();
+		Graphics4::end();
+		Graphics4::swapBuffers();
+
+		imageTime += afterImages - start;
+		rectTime += afterRects - afterImages;
+		spriteTime += afterSprites - afterRects;
+		++frames;
+
+		if (afterSprites - lastReport > 1.0) {
+			double count = static_cast<double>(spritesPerFrame) * frames;
+			printf("drawScaledSubImage: %.0f sprites/s, fillRect: %.0f rects/s, drawSprites: %.0f sprites/s\n", count / imageTime, count / rectTime,
+			       count / spriteTime);
+			imageTime = rectTime = spriteTime = 0;
+			frames = 0;
+			lastReport = afterSprites;
+		}
+	}
+}
+
+int kore(int argc, char** argv) {
+	System::init("Graphics2Benchmark", width, height);
+	System::setCallback(update);
+
+	g2 = new Graphics2::Graphics2(width, height);
+
+	texture = new Graphics4::Texture(16, 16, Graphics4::Image::RGBA32, false);
+	u8* data = texture->lock();
+	memset(data, 0xff, texture->stride() * 16);
+	texture->unlock();
+
+	sprites = new Graphics2::Sprite[spritesPerFrame];
+	for (int i = 0; i < spritesPerFrame; ++i) {
+		Graphics2::Sprite& sprite = sprites[i];
+		sprite.sx = sprite.sy = 0;
+		sprite.sw = sprite.sh = 16;
+		sprite.dx = position(i, width);
+		sprite.dy = position(i * 3, height);
+		sprite.dw = sprite.dh = 16;
+		sprite.color = Graphics1::Color::White;
+	}
+
+	lastReport = System::time();
+	System::start();
+
+	return 0;
+}
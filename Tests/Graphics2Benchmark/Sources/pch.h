@@ -0,0 +1 @@
+#include <Kore/pch.h>
@@ -0,0 +1,6 @@
+let project = new Project('Graphics2Benchmark');
+
+project.addFile('Sources/**');
+project.setDebugDir('Deployment');
+
+resolve(project);